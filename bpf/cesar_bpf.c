@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * Loader for bpf/tcp_cesar.bpf.c: sets the parameters, loads the
+ * struct_ops through its skeleton and attaches it as a congestion control
+ * with no module build, rmmod or reboot.
+ *
+ * The link is pinned under /sys/fs/bpf, so the algorithm stays registered
+ * after the loader exits. Loading again with the same name swaps the new
+ * object in through the pinned link: connections opened from then on run
+ * it, existing ones keep the version they started with until they close.
+ * -d unpins it, which unregisters the name once no connection uses it.
+ *
+ * Usage: cesar_bpf [-n name] [-s su] [-a alpha] [-b beta] [-g gamma]
+ *                  [-w bin_us] [-E]
+ *        cesar_bpf [-n name] -d
+ *
+ * -s, -a, -b, -g and -w set profile 0 of the module parameters they
+ * mirror. One struct_ops runs one profile, so there is no "cesar_bpf1":
+ * load another object under its own -n name for a second set of values.
+ * -E negotiates ECN and reacts to CE marks, as cesar_ecn=1 does for the
+ * module. Every network namespace shares one set of values.
+ * Needs kernel 6.4 or later for struct_ops links, and libbpf 1.4.
+ * cesar_bpf_main follows the cong_control arguments 6.10 changed, so
+ * newer kernels work as they are.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <bpf/bpf.h>
+#include <bpf/btf.h>
+#include <bpf/libbpf.h>
+
+#include "tcp_cesar.skel.h"
+
+#define CESAR_NR_PROFILES	8
+#define TCP_CONG_NEEDS_ECN	0x2	/* include/net/tcp.h */
+#define PIN_DIR			"/sys/fs/bpf"
+
+/* Layout of struct cesar_params in tcp_cesar.c, checked against BTF */
+struct cesar_params {
+	int	scheduling_unit[CESAR_NR_PROFILES];
+	int	alpha[CESAR_NR_PROFILES];
+	int	beta[CESAR_NR_PROFILES];
+	int	gamma[CESAR_NR_PROFILES];
+	int	pattern_bin_us[CESAR_NR_PROFILES];
+	int	su_pacing[CESAR_NR_PROFILES];
+	int	share[CESAR_NR_PROFILES];	/* module only */
+};
+
+/* Static globals of tcp_cesar.c are not in the skeleton: find them in the
+ * object's BTF and return where their initial value sits in sec's map.
+ */
+static void *cesar_bpf_var(struct bpf_object *obj, const char *sec,
+			   const char *name, size_t size)
+{
+	const struct btf *btf = bpf_object__btf(obj);
+	const struct btf_var_secinfo *vsi;
+	const struct btf_type *t;
+	struct bpf_map *map;
+	int id, i;
+
+	id = btf__find_by_name_kind(btf, sec, BTF_KIND_DATASEC);
+	if (id < 0)
+		return NULL;
+	t = btf__type_by_id(btf, id);
+	vsi = btf_var_secinfos(t);
+	for (i = 0; i < btf_vlen(t); i++, vsi++) {
+		const struct btf_type *var = btf__type_by_id(btf, vsi->type);
+
+		if (strcmp(btf__name_by_offset(btf, var->name_off), name))
+			continue;
+		if (vsi->size != size)
+			return NULL;
+		bpf_object__for_each_map(map, obj) {
+			const char *map_name = bpf_map__name(map);
+			size_t len = strlen(map_name), sec_len = strlen(sec);
+			size_t value_size;
+			char *data;
+
+			if (!bpf_map__is_internal(map) || len < sec_len ||
+			    strcmp(map_name + len - sec_len, sec))
+				continue;
+			data = bpf_map__initial_value(map, &value_size);
+			if (!data || vsi->offset + size > value_size)
+				return NULL;
+			return data + vsi->offset;
+		}
+	}
+	return NULL;
+}
+
+/* arg into profile 0 of param, the one cesar_bpf runs */
+static int parse_profile0(const char *arg, int *param)
+{
+	char *end;
+
+	param[0] = strtol(arg, &end, 0);
+	return end == arg || *end ? -EINVAL : 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n name] [-s su] [-a alpha] [-b beta] [-g gamma] [-w bin_us] [-E]\n"
+		"       %s [-n name] -d\n",
+		prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = "cesar_bpf", *opt_arg[128] = { 0 };
+	struct cesar_params *params;
+	struct tcp_cesar_bpf *skel;
+	struct bpf_link *link;
+	bool ecn = false, detach = false, replaced = false;
+	char pin[256];
+	int opt, err;
+
+	while ((opt = getopt(argc, argv, "n:s:a:b:g:w:Edh")) != -1) {
+		switch (opt) {
+		case 'n':
+			name = optarg;
+			break;
+		case 's':
+		case 'a':
+		case 'b':
+		case 'g':
+		case 'w':
+			opt_arg[opt] = optarg;
+			break;
+		case 'E':
+			ecn = true;
+			break;
+		case 'd':
+			detach = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+	if (optind != argc || strlen(name) >= 16) {
+		usage(argv[0]);
+		return 2;
+	}
+	snprintf(pin, sizeof(pin), PIN_DIR "/%s", name);
+
+	if (detach) {
+		if (unlink(pin)) {
+			perror(pin);
+			return 1;
+		}
+		return 0;
+	}
+
+	skel = tcp_cesar_bpf__open();
+	if (!skel) {
+		perror("open");
+		return 1;
+	}
+
+	params = cesar_bpf_var(skel->obj, ".data", "cesar_init_params",
+			       sizeof(*params));
+	if (!params) {
+		fprintf(stderr, "cesar_init_params not found or not as expected\n");
+		err = -ENOENT;
+		goto out;
+	}
+	if ((opt_arg['s'] && parse_profile0(opt_arg['s'], params->scheduling_unit)) ||
+	    (opt_arg['a'] && parse_profile0(opt_arg['a'], params->alpha)) ||
+	    (opt_arg['b'] && parse_profile0(opt_arg['b'], params->beta)) ||
+	    (opt_arg['g'] && parse_profile0(opt_arg['g'], params->gamma)) ||
+	    (opt_arg['w'] && parse_profile0(opt_arg['w'], params->pattern_bin_us))) {
+		usage(argv[0]);
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (ecn) {
+		bool *cesar_ecn = cesar_bpf_var(skel->obj, ".bss", "cesar_ecn",
+						sizeof(*cesar_ecn));
+
+		if (!cesar_ecn) {
+			fprintf(stderr, "cesar_ecn not found\n");
+			err = -ENOENT;
+			goto out;
+		}
+		*cesar_ecn = true;
+		skel->struct_ops.cesar_bpf->flags |= TCP_CONG_NEEDS_ECN;
+	}
+	strncpy(skel->struct_ops.cesar_bpf->name, name,
+		sizeof(skel->struct_ops.cesar_bpf->name) - 1);
+
+	err = tcp_cesar_bpf__load(skel);
+	if (err) {
+		fprintf(stderr, "load: %s\n", strerror(-err));
+		goto out;
+	}
+
+	link = bpf_link__open(pin);
+	if (link) {
+		err = bpf_link__update_map(link, skel->maps.cesar_bpf);
+		replaced = true;
+	} else {
+		link = bpf_map__attach_struct_ops(skel->maps.cesar_bpf);
+		err = link ? bpf_link__pin(link, pin) : -errno;
+	}
+	if (err) {
+		fprintf(stderr, "%s %s: %s\n", replaced ? "update" : "attach",
+			pin, strerror(-err));
+		goto out_link;
+	}
+	printf("%s %s, pinned at %s\n", name, replaced ? "replaced" : "attached",
+	       pin);
+
+out_link:
+	bpf_link__destroy(link);
+out:
+	tcp_cesar_bpf__destroy(skel);
+	return err ? 1 : 0;
+}
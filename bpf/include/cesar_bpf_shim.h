@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/*
+ * Just enough of the kernel to compile tcp_cesar.c as a BPF struct_ops
+ * object. Every kernel header tcp_cesar.c includes resolves to a stub
+ * under bpf/include/ that pulls in this file; types come from vmlinux.h,
+ * generated from the running kernel's BTF, and the helpers Cesar calls
+ * are reimplemented here since struct_ops cannot call them.
+ *
+ * Only what bpf_tcp_ca lets a struct_ops program do is modelled: cwnd,
+ * pacing rate and pacing status are the only socket fields it writes.
+ */
+#ifndef _CESAR_BPF_SHIM_H
+#define _CESAR_BPF_SHIM_H
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+#define __read_mostly
+#define __init
+#define __exit
+#define __net_init
+#define __net_exit
+#define __percpu
+#define __always_unused		__attribute__((unused))
+#ifndef likely
+#define likely(x)		__builtin_expect(!!(x), 1)
+#endif
+#ifndef unlikely
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+#endif
+
+#define BITS_PER_BYTE		8
+#define U8_MAX			((u8)~0U)
+#define U16_MAX			((u16)~0U)
+#define U32_MAX			((u32)~0U)
+#define USEC_PER_SEC		1000000UL
+#define NSEC_PER_USEC		1000UL
+#define NSEC_PER_MSEC		1000000UL
+#define HZ			1000
+
+#define BUILD_BUG_ON(cond)	_Static_assert(!(cond), #cond)
+#define sizeof_field(T, m)	sizeof(((T *)0)->m)
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+
+#define min(a, b)		({ typeof(a) __a = (a); typeof(b) __b = (b); __a < __b ? __a : __b; })
+#define max(a, b)		({ typeof(a) __a = (a); typeof(b) __b = (b); __a > __b ? __a : __b; })
+#define min_t(t, a, b)		({ t __a = (a); t __b = (b); __a < __b ? __a : __b; })
+#define max_t(t, a, b)		({ t __a = (a); t __b = (b); __a > __b ? __a : __b; })
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+
+/* As in replay/include/cesar_shim.h: unsigned arguments become signed
+ * first, so abs(u32 - u32) is a distance.
+ */
+#define __abs_choose_expr(x, type, other) __builtin_choose_expr(	\
+	__builtin_types_compatible_p(typeof(x), signed type) ||		\
+	__builtin_types_compatible_p(typeof(x), unsigned type),		\
+	({ signed type __x = (x); __x < 0 ? -__x : __x; }), other)
+#define abs(x)	__abs_choose_expr(x, long long,				\
+		__abs_choose_expr(x, long,				\
+		__abs_choose_expr(x, int,				\
+		__abs_choose_expr(x, short,				\
+		__abs_choose_expr(x, char, (void)0)))))
+
+#define do_div(n, base) ({					\
+	u32 __base = (base);					\
+	u32 __rem = (u64)(n) % __base;				\
+	(n) = (u64)(n) / __base;				\
+	__rem;							\
+})
+
+static __always_inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static __always_inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+	return dividend / divisor;
+}
+
+#define READ_ONCE(x)		(*(volatile typeof(x) *)&(x))
+#define WRITE_ONCE(x, val)	(*(volatile typeof(x) *)&(x) = (val))
+#define memset(s, c, n)		__builtin_memset(s, c, n)
+
+/* Congestion control runs under the socket lock, and struct_ops may not
+ * use atomics on socket fields: a plain compare and store does.
+ */
+#define cmpxchg(ptr, old, new) ({				\
+	typeof(*(ptr)) __old = *(ptr);				\
+	if (__old == (old))					\
+		*(ptr) = (new);					\
+	__old;							\
+})
+
+/* Modules: parameters stay globals the loader writes before load */
+#define module_param(name, type, perm)
+#define module_param_array(name, type, nump, perm)
+#define module_param_array_named(name, array, type, nump, perm)
+#define MODULE_PARM_DESC(name, desc)
+#define MODULE_AUTHOR(x)
+#define MODULE_LICENSE(x)
+#define MODULE_DESCRIPTION(x)
+
+/* HZ is 1000 above, so jiffies are milliseconds */
+#define tcp_jiffies32		((u32)(bpf_ktime_get_ns() / NSEC_PER_MSEC))
+
+/* win_minmax, as in lib/win_minmax.c */
+static __always_inline u32 minmax_get(const struct minmax *m)
+{
+	return m->s[0].v;
+}
+
+static __always_inline u32 minmax_reset(struct minmax *m, u32 t, u32 meas)
+{
+	struct minmax_sample val = { .t = t, .v = meas };
+
+	m->s[2] = m->s[1] = m->s[0] = val;
+	return m->s[0].v;
+}
+
+static u32 minmax_subwin_update(struct minmax *m, u32 win,
+				const struct minmax_sample *val)
+{
+	u32 dt = val->t - m->s[0].t;
+
+	if (unlikely(dt > win)) {
+		m->s[0] = m->s[1];
+		m->s[1] = m->s[2];
+		m->s[2] = *val;
+		if (unlikely(val->t - m->s[0].t > win)) {
+			m->s[0] = m->s[1];
+			m->s[1] = m->s[2];
+			m->s[2] = *val;
+		}
+	} else if (unlikely(m->s[1].t == m->s[0].t) && dt > win / 4) {
+		m->s[2] = m->s[1] = *val;
+	} else if (unlikely(m->s[2].t == m->s[1].t) && dt > win / 2) {
+		m->s[2] = *val;
+	}
+	return m->s[0].v;
+}
+
+static u32 minmax_running_max(struct minmax *m, u32 win, u32 t, u32 meas)
+{
+	struct minmax_sample val = { .t = t, .v = meas };
+
+	if (unlikely(val.v >= m->s[0].v) ||
+	    unlikely(val.t - m->s[2].t > win))
+		return minmax_reset(m, t, meas);
+
+	if (unlikely(val.v >= m->s[1].v))
+		m->s[2] = m->s[1] = val;
+	else if (unlikely(val.v >= m->s[2].v))
+		m->s[2] = val;
+
+	return minmax_subwin_update(m, win, &val);
+}
+
+/* Sockets, as bpf_tcp_ca sees them: casts of the struct_ops argument */
+static __always_inline struct inet_sock *inet_sk(const struct sock *sk)
+{
+	return (struct inet_sock *)sk;
+}
+
+static __always_inline struct inet_connection_sock *inet_csk(const struct sock *sk)
+{
+	return (struct inet_connection_sock *)sk;
+}
+
+static __always_inline void *inet_csk_ca(const struct sock *sk)
+{
+	return (void *)inet_csk(sk)->icsk_ca_priv;
+}
+
+static __always_inline struct tcp_sock *tcp_sk(const struct sock *sk)
+{
+	return (struct tcp_sock *)sk;
+}
+
+/* TCP: #defines, which vmlinux.h cannot carry */
+#define TCP_INIT_CWND		10
+#define TCP_INFINITE_SSTHRESH	0x7fffffff
+#define MAX_TCP_HEADER		320
+#define GSO_MAX_SIZE		65536
+#define TCP_CONG_NON_RESTRICTED	0x1
+#define TCP_CONG_NEEDS_ECN	0x2
+#define ICSK_CA_PRIV_SIZE	sizeof_field(struct inet_connection_sock, icsk_ca_priv)
+
+static __always_inline unsigned int tcp_left_out(const struct tcp_sock *tp)
+{
+	return tp->sacked_out + tp->lost_out;
+}
+
+static __always_inline unsigned int tcp_packets_in_flight(const struct tcp_sock *tp)
+{
+	return tp->packets_out - tcp_left_out(tp) + tp->retrans_out;
+}
+
+static __always_inline bool before(u32 seq1, u32 seq2)
+{
+	return (s32)(seq1 - seq2) < 0;
+}
+#define after(seq2, seq1)	before(seq1, seq2)
+
+#endif /* _CESAR_BPF_SHIM_H */
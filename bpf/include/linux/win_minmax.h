@@ -0,0 +1,2 @@
+/* bpf stub, see cesar_bpf_shim.h */
+#include "cesar_bpf_shim.h"
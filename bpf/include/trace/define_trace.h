@@ -0,0 +1 @@
+/* bpf stub, see linux/tracepoint.h */
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * tcp_cesar as a BPF struct_ops congestion control, registered as
+ * "cesar_bpf" next to (or instead of) the module's "cesar".
+ *
+ * The algorithm is tcp_cesar.c itself, built against include/cesar_bpf_shim.h
+ * the way the replay harness builds it against its own shim, so the two
+ * cannot drift. CESAR_BPF drops what a struct_ops object has no use for:
+ * module parameters, the netns sysctls and /proc stats, get_info(), the
+ * cesar_share destination table, the tracepoints and the relay sample
+ * capture. SU pacing stays off, since struct_ops may not move
+ * tcp_wstamp_ns.
+ *
+ * cesar_bpf.c loads it from the generated skeleton, writes the parameters
+ * and attaches it; loading again replaces it in place.
+ */
+#define CESAR_BPF
+#include "../tcp_cesar.c"
+
+BUILD_BUG_ON(sizeof(struct cesar) > ICSK_CA_PRIV_SIZE);
+
+extern int LINUX_KERNEL_VERSION __kconfig;
+
+SEC("struct_ops/cesar_bpf_init")
+void BPF_PROG(cesar_bpf_init, struct sock *sk)
+{
+	cesar_init(sk);
+}
+
+/* cong_control is (sk, rs) up to 6.9 and (sk, ack, flag, rs) from 6.10.
+ * LINUX_KERNEL_VERSION is a constant to the verifier, so it only walks the
+ * branch for the running kernel and never sees ctx[3] on an older one.
+ */
+SEC("struct_ops/cesar_bpf_main")
+void cesar_bpf_main(unsigned long long *ctx)
+{
+	struct sock *sk = (void *)ctx[0];
+	const struct rate_sample *rs;
+
+	if (LINUX_KERNEL_VERSION >= KERNEL_VERSION(6, 10, 0))
+		rs = (void *)ctx[3];
+	else
+		rs = (void *)ctx[1];
+	cesar_main(sk, rs);
+}
+
+SEC("struct_ops/cesar_bpf_sndbuf_expand")
+u32 BPF_PROG(cesar_bpf_sndbuf_expand, struct sock *sk)
+{
+	return cesar_sndbuf_expand(sk);
+}
+
+SEC("struct_ops/cesar_bpf_undo_cwnd")
+u32 BPF_PROG(cesar_bpf_undo_cwnd, struct sock *sk)
+{
+	return cesar_undo_cwnd(sk);
+}
+
+SEC("struct_ops/cesar_bpf_ssthresh")
+u32 BPF_PROG(cesar_bpf_ssthresh, struct sock *sk)
+{
+	return cesar_ssthresh(sk);
+}
+
+SEC("struct_ops/cesar_bpf_min_tso_segs")
+u32 BPF_PROG(cesar_bpf_min_tso_segs, struct sock *sk)
+{
+	return cesar_min_tso_segs(sk);
+}
+
+SEC("struct_ops/cesar_bpf_set_state")
+void BPF_PROG(cesar_bpf_set_state, struct sock *sk, u8 new_state)
+{
+	cesar_set_state(sk, new_state);
+}
+
+SEC("struct_ops/cesar_bpf_cwnd_event")
+void BPF_PROG(cesar_bpf_cwnd_event, struct sock *sk, enum tcp_ca_event event)
+{
+	cesar_cwnd_event(sk, event);
+}
+
+SEC("struct_ops/cesar_bpf_acked")
+void BPF_PROG(cesar_bpf_acked, struct sock *sk, const struct ack_sample *sample)
+{
+	cesar_acked(sk, sample);
+}
+
+SEC("struct_ops/cesar_bpf_release")
+void BPF_PROG(cesar_bpf_release, struct sock *sk)
+{
+	cesar_release(sk);
+}
+
+SEC(".struct_ops.link")
+struct tcp_congestion_ops cesar_bpf = {
+	.flags		= TCP_CONG_NON_RESTRICTED,
+	.name		= "cesar_bpf",
+	.init		= (void *)cesar_bpf_init,
+	.cong_control	= (void *)cesar_bpf_main,
+	.sndbuf_expand	= (void *)cesar_bpf_sndbuf_expand,
+	.undo_cwnd	= (void *)cesar_bpf_undo_cwnd,
+	.ssthresh	= (void *)cesar_bpf_ssthresh,
+	.min_tso_segs	= (void *)cesar_bpf_min_tso_segs,
+	.set_state	= (void *)cesar_bpf_set_state,
+	.cwnd_event	= (void *)cesar_bpf_cwnd_event,
+	.pkts_acked	= (void *)cesar_bpf_acked,
+	.release	= (void *)cesar_bpf_release,
+};
+
+char _license[] SEC("license") = "Dual BSD/GPL";
@@ -7,9 +7,6 @@ beta=5
 gamma=8
 
 if lsmod | grep tcp_cesar; then
-	echo $mode > /sys/module/tcp_cesar/parameters/cesar_mode_outside
-    echo "mode         "$(cat /sys/module/tcp_cesar/parameters/cesar_mode_outside)
-
 	echo $su > /sys/module/tcp_cesar/parameters/cesar_scheduling_unit
     echo "su           "$(cat /sys/module/tcp_cesar/parameters/cesar_scheduling_unit)
 
@@ -21,6 +18,15 @@ if lsmod | grep tcp_cesar; then
 
 	echo $gamma > /sys/module/tcp_cesar/parameters/cesar_gamma
     echo "gamma        "$(cat /sys/module/tcp_cesar/parameters/cesar_gamma)
+
+    echo "per-class profiles: write comma lists, e.g. echo 2,2,1 > .../cesar_alpha;"
+    echo "    a socket uses entry i with setsockopt(TCP_CONGESTION, \"cesar<i>\"), entry 0 with \"cesar\"; running flows see writes"
+    echo "other netns (containers): sysctl net.ipv4.tcp_cesar_{scheduling_unit,alpha,beta,gamma,pattern_bin_us,su_pacing,share}"
+    echo "SU-aligned burst pacing (off by default): echo 1 > .../cesar_su_pacing"
+    echo "share su/min_rtt/bw between flows to one destination (off by default): echo 1 > .../cesar_share"
+    echo "ECN/L4S response: load with insmod tcp_cesar.ko cesar_ecn=1 (now: $(cat /sys/module/tcp_cesar/parameters/cesar_ecn))"
+    echo "per-ACK logs: echo 1 > /sys/kernel/tracing/events/tcp_cesar/enable"
+    echo "event counters for this netns: cat /proc/net/tcp_cesar_stat"
 else
     echo "add cesar module first"
     exit 1
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * On/off traffic over one long-lived connection, the way a DASH/HLS
+ * player fetches segments: the receiver asks for a chunk of -s bytes
+ * every -i milliseconds and prints how long each took to arrive, in ms,
+ * one per line. The sender answers every request with that many bytes
+ * using the congestion control given with -C, so between chunks the
+ * connection runs dry and goes idle, which is what run_benchmark.sh -V
+ * measures.
+ *
+ * Usage: cesar_chunk -l addr:port [-C cc]
+ *        cesar_chunk -c addr:port [-s bytes] [-i period_ms] [-n chunks]
+ */
+#define _GNU_SOURCE
+#include <endian.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int parse_addr(const char *arg, struct sockaddr_in *sin)
+{
+	char host[64];
+	const char *colon = strrchr(arg, ':');
+
+	if (!colon || colon - arg >= (long)sizeof(host))
+		return -EINVAL;
+	memcpy(host, arg, colon - arg);
+	host[colon - arg] = '\0';
+
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_port = htons(atoi(colon + 1));
+	return inet_pton(AF_INET, host, &sin->sin_addr) == 1 ? 0 : -EINVAL;
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = read(fd, buf, len);
+
+		if (n <= 0)
+			return n ? -errno : -EPIPE;
+		buf = (char *)buf + n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Sender: one connection, a chunk per 8-byte big-endian request */
+static int run_sender(const struct sockaddr_in *sin, const char *cc)
+{
+	static char buf[1 << 16];
+	int one = 1, lfd, fd;
+	uint64_t req;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0 ||
+	    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+	    (cc && setsockopt(lfd, IPPROTO_TCP, TCP_CONGESTION, cc, strlen(cc))) ||
+	    bind(lfd, (const struct sockaddr *)sin, sizeof(*sin)) ||
+	    listen(lfd, 1)) {
+		perror("listen");
+		return 1;
+	}
+	fd = accept(lfd, NULL, NULL);
+	close(lfd);
+	if (fd < 0) {
+		perror("accept");
+		return 1;
+	}
+
+	while (!read_full(fd, &req, sizeof(req))) {
+		uint64_t left = be64toh(req);
+
+		while (left) {
+			ssize_t n = write(fd, buf, left < sizeof(buf) ? left : sizeof(buf));
+
+			if (n <= 0) {
+				perror("write");
+				return 1;
+			}
+			left -= n;
+		}
+	}
+	close(fd);
+	return 0;
+}
+
+static int run_receiver(const struct sockaddr_in *sin, uint64_t size,
+			uint32_t period_ms, uint32_t chunks)
+{
+	static char buf[1 << 16];
+	uint64_t start, next;
+	uint32_t i;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (const struct sockaddr *)sin, sizeof(*sin))) {
+		perror("connect");
+		return 1;
+	}
+
+	next = now_us();
+	for (i = 0; i < chunks; i++) {
+		uint64_t req = htobe64(size), left = size;
+
+		start = now_us();
+		if (write(fd, &req, sizeof(req)) != sizeof(req)) {
+			perror("write");
+			return 1;
+		}
+		while (left) {
+			size_t len = left < sizeof(buf) ? left : sizeof(buf);
+
+			if (read_full(fd, buf, len)) {
+				fprintf(stderr, "connection closed mid-chunk\n");
+				return 1;
+			}
+			left -= len;
+		}
+		printf("%.1f\n", (now_us() - start) / 1000.0);
+		fflush(stdout);
+
+		next += (uint64_t)period_ms * 1000;
+		if (next > now_us())
+			usleep(next - now_us());
+	}
+	close(fd);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -l addr:port [-C cc]\n"
+		"       %s -c addr:port [-s bytes] [-i period_ms] [-n chunks]\n",
+		prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *listen_addr = NULL, *connect_addr = NULL, *cc = NULL;
+	uint64_t size = 2000000;
+	uint32_t period_ms = 4000, chunks = 20;
+	struct sockaddr_in sin;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "l:c:C:s:i:n:h")) != -1) {
+		switch (opt) {
+		case 'l':
+			listen_addr = optarg;
+			break;
+		case 'c':
+			connect_addr = optarg;
+			break;
+		case 'C':
+			cc = optarg;
+			break;
+		case 's':
+			size = strtoull(optarg, NULL, 0);
+			break;
+		case 'i':
+			period_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			chunks = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+	if (!listen_addr == !connect_addr || !size ||
+	    parse_addr(listen_addr ? listen_addr : connect_addr, &sin)) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if (listen_addr)
+		return run_sender(&sin, cc);
+	return run_receiver(&sin, size, period_ms, chunks);
+}
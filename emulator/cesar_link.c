@@ -0,0 +1,594 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * Trace-driven cellular link emulator.
+ *
+ * Bridges two TUN devices: cesar0 in the current network namespace (the
+ * sender side) and cesar1 in the namespace given with -n (the receiver
+ * side). Downlink packets, cesar0 -> cesar1, wait in a drop-tail queue of
+ * -b bytes and are only released on scheduling unit boundaries, every -s
+ * microseconds with up to -j microseconds of jitter, so the receiver sees
+ * data, and the sender sees ACKs, in SU-aligned bursts. How many bytes an
+ * SU may release is the sum of the per-TTI capacities read from the trace
+ * file, one byte count per -t microsecond TTI, replayed in a loop.
+ * Uplink packets (ACKs) are only delayed. Both directions add -d
+ * microseconds of one-way propagation delay. -H secs:delay_us switches that
+ * delay once, secs into the run, to emulate a handover to a cell with a
+ * different base RTT. -K mark_us sets CE, instead of waiting for the
+ * buffer to overflow, on ECN-capable downlink packets that queued longer
+ * than mark_us: an L4S-style step AQM in front of the cell.
+ *
+ * -A n and -G window_us coalesce the uplink the way the sender's NIC and
+ * the network between do. -A thins pure ACKs: a queued one takes the place
+ * of up to n - 1 that follow it on the same connection, and leaves when the
+ * last of them would have, so the sender sees one stretch ACK for n, as
+ * behind an ACK-thinning middlebox. -G releases the uplink on a window_us
+ * grid, so ACKs reach the sender in batches like GRO and interrupt
+ * moderation hand them over. GRO itself never merges pure ACKs; the
+ * batching is what it changes for them.
+ *
+ * With -l, every released downlink packet is logged as
+ * "release_time_us queue_delay_us len" for run_benchmark.sh.
+ *
+ * Usage: cesar_link -n /var/run/netns/NAME [-s su_us] [-t tti_us]
+ *                   [-j jitter_us] [-b buffer_bytes] [-d delay_us]
+ *                   [-H secs:delay_us] [-K mark_us] [-A n] [-G window_us]
+ *                   [-S seed] [-l qdelay.log] capacity.trace
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <sys/ioctl.h>
+
+#define LINK_MTU	2048
+
+struct pkt {
+	struct pkt *next;
+	uint64_t time_us;
+	uint32_t len;
+	uint8_t data[LINK_MTU];
+};
+
+struct pktq {
+	struct pkt *head;
+	struct pkt *tail;
+	uint64_t bytes;
+};
+
+struct link {
+	int srv_fd;
+	int cli_fd;
+
+	uint32_t su_us;
+	uint32_t tti_us;
+	uint32_t jitter_us;
+	uint64_t buffer_bytes;
+	uint32_t delay_us;
+	uint64_t handover_us;
+	uint32_t handover_delay_us;
+	uint32_t mark_us;
+	uint32_t thin;
+	uint32_t batch_us;
+	uint64_t rng;
+
+	uint32_t *capacity;
+	size_t capacity_len;
+	size_t capacity_pos;
+
+	struct pktq bottleneck;
+	struct pktq down;
+	struct pktq up;
+
+	uint64_t next_su_us;
+	uint64_t su_base_us;
+	uint64_t credit;
+	uint32_t up_merged;	/* ACKs the uplink tail stands in for */
+
+	FILE *log;
+
+	uint64_t down_pkts;
+	uint64_t down_drops;
+	uint64_t down_marks;
+	uint64_t up_pkts;
+	uint64_t up_thinned;
+};
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* xorshift64*, seeded from -S so jitter is repeatable. */
+static uint64_t link_rand(struct link *l)
+{
+	l->rng ^= l->rng >> 12;
+	l->rng ^= l->rng << 25;
+	l->rng ^= l->rng >> 27;
+	return l->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static void pktq_push(struct pktq *q, struct pkt *p)
+{
+	p->next = NULL;
+	if (q->tail)
+		q->tail->next = p;
+	else
+		q->head = p;
+	q->tail = p;
+	q->bytes += p->len;
+}
+
+static struct pkt *pktq_pop(struct pktq *q)
+{
+	struct pkt *p = q->head;
+
+	if (!p)
+		return NULL;
+	q->head = p->next;
+	if (!q->head)
+		q->tail = NULL;
+	q->bytes -= p->len;
+	return p;
+}
+
+static int tun_open(const char *name)
+{
+	struct ifreq ifr;
+	int fd;
+
+	fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+		int err = -errno;
+
+		close(fd);
+		return err;
+	}
+	return fd;
+}
+
+/* Open cesar1 inside the receiver namespace, then switch back. */
+static int tun_open_netns(const char *name, const char *netns)
+{
+	int self, target, fd;
+
+	self = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+	if (self < 0)
+		return -errno;
+	target = open(netns, O_RDONLY | O_CLOEXEC);
+	if (target < 0) {
+		fd = -errno;
+		goto out_self;
+	}
+	if (setns(target, CLONE_NEWNET) < 0) {
+		fd = -errno;
+		goto out_target;
+	}
+	fd = tun_open(name);
+	if (setns(self, CLONE_NEWNET) < 0 && fd >= 0) {
+		close(fd);
+		fd = -errno;
+	}
+out_target:
+	close(target);
+out_self:
+	close(self);
+	return fd;
+}
+
+static int load_capacity(struct link *l, const char *path)
+{
+	FILE *f = fopen(path, "r");
+	size_t cap = 0;
+	char line[64];
+
+	if (!f)
+		return -errno;
+
+	while (fgets(line, sizeof(line), f)) {
+		char *end;
+		unsigned long bytes;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		bytes = strtoul(line, &end, 10);
+		if (end == line)
+			continue;
+		if (l->capacity_len == cap) {
+			uint32_t *c;
+
+			cap = cap ? cap * 2 : 1024;
+			c = realloc(l->capacity, cap * sizeof(*c));
+			if (!c) {
+				fclose(f);
+				return -ENOMEM;
+			}
+			l->capacity = c;
+		}
+		l->capacity[l->capacity_len++] = bytes;
+	}
+	fclose(f);
+	return l->capacity_len ? 0 : -EINVAL;
+}
+
+/* Grant for one SU: the capacity of every TTI it spans. */
+static uint64_t su_grant(struct link *l)
+{
+	uint32_t ttis = l->su_us / l->tti_us;
+	uint64_t bytes = 0;
+
+	if (!ttis)
+		ttis = 1;
+	while (ttis--) {
+		bytes += l->capacity[l->capacity_pos++];
+		if (l->capacity_pos == l->capacity_len)
+			l->capacity_pos = 0;
+	}
+	return bytes;
+}
+
+static void schedule_next_su(struct link *l)
+{
+	int64_t jitter = 0;
+
+	l->su_base_us += l->su_us;
+	if (l->jitter_us)
+		jitter = (int64_t)(link_rand(l) % (2 * l->jitter_us + 1)) -
+			 l->jitter_us;
+	l->next_su_us = l->su_base_us + jitter;
+}
+
+/* Set CE on an ECT(0)/ECT(1) IPv4 or IPv6 packet; false if it is not ECT. */
+static bool mark_ce(struct pkt *p)
+{
+	uint8_t *ip = p->data;
+
+	if (p->len >= 20 && ip[0] >> 4 == 4) {
+		uint32_t sum;
+
+		if (!(ip[1] & 3) || (ip[1] & 3) == 3)
+			return (ip[1] & 3) == 3;
+		/* RFC 1624 incremental update of the header checksum */
+		sum = (uint16_t)~((ip[10] << 8) | ip[11]);
+		sum += (uint16_t)~((ip[0] << 8) | ip[1]);
+		ip[1] |= 3;
+		sum += (ip[0] << 8) | ip[1];
+		sum = (sum & 0xffff) + (sum >> 16);
+		sum = (sum & 0xffff) + (sum >> 16);
+		ip[10] = ~sum >> 8;
+		ip[11] = ~sum;
+		return true;
+	}
+	if (p->len >= 40 && ip[0] >> 4 == 6) {
+		/* traffic class straddles bytes 0 and 1, ECN is bits 4-5 of 1 */
+		if (!(ip[1] & 0x30))
+			return false;
+		ip[1] |= 0x30;
+		return true;
+	}
+	return false;
+}
+
+/* SU boundary: release as much of the bottleneck queue as the grant allows. */
+static void release_su(struct link *l, uint64_t now)
+{
+	struct pkt *p;
+
+	l->credit += su_grant(l);
+	while ((p = l->bottleneck.head) && p->len <= l->credit) {
+		pktq_pop(&l->bottleneck);
+		l->credit -= p->len;
+		if (l->mark_us && now - p->time_us > l->mark_us && mark_ce(p))
+			l->down_marks++;
+		if (l->log)
+			fprintf(l->log, "%llu %llu %u\n",
+				(unsigned long long)now,
+				(unsigned long long)(now - p->time_us), p->len);
+		p->time_us = now + l->delay_us;
+		pktq_push(&l->down, p);
+	}
+	/* Unused grant is lost, except what a waiting packet still needs. */
+	if (!l->bottleneck.head)
+		l->credit = 0;
+	else if (l->credit > l->bottleneck.head->len)
+		l->credit = l->bottleneck.head->len;
+}
+
+/* Addresses, ports and flags of a pure TCP ACK, or 0 if p is not one */
+static size_t ack_key(const struct pkt *p, uint8_t *key)
+{
+	const uint8_t *ip = p->data, *th;
+	size_t hlen, alen, off;
+
+	if (p->len >= 20 && ip[0] >> 4 == 4) {
+		hlen = (ip[0] & 0xf) * 4;
+		if (hlen < 20 || ip[9] != 6 || (ip[6] & 0x3f) || ip[7])	/* TCP, unfragmented */
+			return 0;
+		off = 12;
+		alen = 8;
+	} else if (p->len >= 40 && ip[0] >> 4 == 6) {
+		hlen = 40;
+		if (ip[6] != 6)		/* no extension headers */
+			return 0;
+		off = 8;
+		alen = 32;
+	} else {
+		return 0;
+	}
+	if (p->len < hlen + 20)
+		return 0;
+	th = ip + hlen;
+	/* ACK alone, maybe with ECE or CWR; no payload */
+	if ((th[13] & 0x3f) != 0x10 || p->len != hlen + (th[12] >> 4) * 4)
+		return 0;
+
+	memcpy(key, ip + off, alen);
+	memcpy(key + alen, th, 4);
+	key[alen + 4] = th[13];
+	return alen + 5;
+}
+
+/* -A: fold p into the uplink tail if both are pure ACKs of one connection */
+static bool thin_ack(struct link *l, const struct pkt *p)
+{
+	uint8_t key[40], tail_key[40];
+	struct pkt *tail = l->up.tail;
+	size_t len;
+
+	if (!tail || l->up_merged + 1 >= l->thin)
+		return false;
+	len = ack_key(p, key);
+	if (!len || ack_key(tail, tail_key) != len || memcmp(key, tail_key, len))
+		return false;
+
+	l->up.bytes += p->len;
+	l->up.bytes -= tail->len;
+	memcpy(tail->data, p->data, p->len);
+	tail->len = p->len;
+	tail->time_us = p->time_us;
+	l->up_merged++;
+	l->up_thinned++;
+	return true;
+}
+
+static void flush_due(struct pktq *q, int fd, uint64_t now, uint64_t *count)
+{
+	struct pkt *p;
+
+	while ((p = q->head) && p->time_us <= now) {
+		pktq_pop(q);
+		if (write(fd, p->data, p->len) == (ssize_t)p->len)
+			(*count)++;
+		free(p);
+	}
+}
+
+static void read_tun(struct link *l, int fd, bool downlink)
+{
+	for (;;) {
+		struct pkt *p = malloc(sizeof(*p));
+		ssize_t n;
+
+		if (!p)
+			return;
+		n = read(fd, p->data, sizeof(p->data));
+		if (n <= 0) {
+			free(p);
+			return;
+		}
+		p->len = n;
+		p->time_us = now_us();
+
+		if (!downlink) {
+			p->time_us += l->delay_us;
+			if (l->batch_us)
+				p->time_us += l->batch_us - p->time_us % l->batch_us;
+			if (l->thin > 1 && thin_ack(l, p)) {
+				free(p);
+				continue;
+			}
+			pktq_push(&l->up, p);
+			l->up_merged = 0;
+		} else if (l->bottleneck.bytes + p->len > l->buffer_bytes) {
+			l->down_drops++;
+			free(p);
+		} else {
+			pktq_push(&l->bottleneck, p);
+		}
+	}
+}
+
+static uint64_t next_deadline(const struct link *l)
+{
+	uint64_t t = l->next_su_us;
+
+	if (l->down.head && l->down.head->time_us < t)
+		t = l->down.head->time_us;
+	if (l->up.head && l->up.head->time_us < t)
+		t = l->up.head->time_us;
+	return t;
+}
+
+static void run(struct link *l)
+{
+	struct pollfd pfd[2] = {
+		{ .fd = l->srv_fd, .events = POLLIN },
+		{ .fd = l->cli_fd, .events = POLLIN },
+	};
+
+	l->su_base_us = now_us();
+	if (l->handover_us)
+		l->handover_us += l->su_base_us;
+	schedule_next_su(l);
+
+	while (!stop) {
+		uint64_t now = now_us(), deadline = next_deadline(l);
+		struct timespec ts = { 0 };
+
+		if (deadline > now) {
+			ts.tv_sec = (deadline - now) / 1000000;
+			ts.tv_nsec = (deadline - now) % 1000000 * 1000;
+		}
+		if (ppoll(pfd, 2, &ts, NULL) < 0 && errno != EINTR)
+			break;
+
+		if (pfd[0].revents & POLLIN)
+			read_tun(l, l->srv_fd, true);
+		if (pfd[1].revents & POLLIN)
+			read_tun(l, l->cli_fd, false);
+
+		now = now_us();
+		if (l->handover_us && now >= l->handover_us) {
+			l->delay_us = l->handover_delay_us;
+			l->handover_us = 0;
+		}
+		while (l->next_su_us <= now) {
+			release_su(l, now);
+			schedule_next_su(l);
+		}
+		flush_due(&l->down, l->cli_fd, now, &l->down_pkts);
+		flush_due(&l->up, l->srv_fd, now, &l->up_pkts);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -n netns_path [-s su_us] [-t tti_us] [-j jitter_us]\n"
+		"       [-b buffer_bytes] [-d delay_us] [-H secs:delay_us] [-K mark_us]\n"
+		"       [-A n] [-G window_us] [-S seed] [-l qdelay.log] capacity.trace\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct link l = {
+		.su_us = 5000,
+		.tti_us = 1000,
+		.buffer_bytes = 1 << 20,
+		.delay_us = 20000,
+		.rng = 1,
+	};
+	const char *netns = NULL, *log = NULL;
+	unsigned long secs;
+	int opt, err;
+
+	while ((opt = getopt(argc, argv, "n:s:t:j:b:d:H:K:A:G:S:l:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			netns = optarg;
+			break;
+		case 's':
+			l.su_us = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			l.tti_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'j':
+			l.jitter_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			l.buffer_bytes = strtoull(optarg, NULL, 0);
+			break;
+		case 'd':
+			l.delay_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'H':
+			if (sscanf(optarg, "%lu:%u", &secs,
+				   &l.handover_delay_us) != 2 || !secs) {
+				usage(argv[0]);
+				return 2;
+			}
+			l.handover_us = secs * 1000000;
+			break;
+		case 'K':
+			l.mark_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'A':
+			l.thin = strtoul(optarg, NULL, 0);
+			break;
+		case 'G':
+			l.batch_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			l.rng = strtoull(optarg, NULL, 0) ?: 1;
+			break;
+		case 'l':
+			log = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+	if (!netns || optind != argc - 1 || !l.su_us || !l.tti_us ||
+	    l.jitter_us >= l.su_us) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	err = load_capacity(&l, argv[optind]);
+	if (err) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(-err));
+		return 1;
+	}
+	if (log) {
+		l.log = fopen(log, "w");
+		if (!l.log) {
+			perror(log);
+			return 1;
+		}
+	}
+
+	l.srv_fd = tun_open("cesar0");
+	if (l.srv_fd < 0) {
+		fprintf(stderr, "cesar0: %s\n", strerror(-l.srv_fd));
+		return 1;
+	}
+	l.cli_fd = tun_open_netns("cesar1", netns);
+	if (l.cli_fd < 0) {
+		fprintf(stderr, "cesar1 in %s: %s\n", netns, strerror(-l.cli_fd));
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	run(&l);
+
+	fprintf(stderr, "downlink %llu pkts %llu drops %llu marks, uplink %llu pkts %llu thinned\n",
+		(unsigned long long)l.down_pkts,
+		(unsigned long long)l.down_drops,
+		(unsigned long long)l.down_marks,
+		(unsigned long long)l.up_pkts,
+		(unsigned long long)l.up_thinned);
+	if (l.log)
+		fclose(l.log);
+	return 0;
+}
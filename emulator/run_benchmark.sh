@@ -0,0 +1,358 @@
+#!/bin/bash
+#
+# End-to-end benchmark over cesar_link: one bulk iperf3 flow per congestion
+# control, each on a fresh emulated cellular link, reporting throughput,
+# RTT percentiles (sampled from ss) and downlink queueing delay
+# percentiles (logged by cesar_link).
+#
+# usage: sudo ./run_benchmark.sh [-T capacity.trace | -r rate_mbit]
+#            [-s su_us] [-j jitter_us] [-b buffer_bytes] [-d base_rtt_us]
+#            [-t seconds] [-H secs:base_rtt_us] [-K mark_us] [-S seed]
+#            [-A n] [-G window_us] [-F "sizes"] [-V bytes:period_ms] [-n runs]
+#            [-C] [-U] [-o outdir] [cc ...]
+#
+# -F replaces the bulk run with short transfers of each size (iperf3 -n
+# syntax, e.g. "100K 1M 10M"), -n runs apiece from a fresh connection, and
+# reports median and 95th percentile flow completion times in ms; this is
+# what STARTUP and DRAIN decide.
+#
+# -V replaces it with on/off traffic on one connection, like a video
+# player fetching a segment every period_ms (cesar_chunk.c): -n chunks
+# after a first one, which also covers STARTUP and is left out, and
+# median and 95th percentile chunk download times in ms. This is what
+# idle restarts and app-limited samples decide.
+#
+# -H changes the base RTT secs into each run, like a handover to another
+# cell; compare the RTT percentiles with and without it. -K has the link
+# CE-mark ECN-capable packets queued longer than mark_us; load tcp_cesar
+# with cesar_ecn=1 (and compare against dctcp) to exercise the ECN path.
+#
+# -A thins the ACKs to one stretch ACK for every n and -G hands them to
+# the sender in window_us batches, as GRO and interrupt moderation do (see
+# cesar_link.c). -U adds su_ok: the share of cesar's SU decisions, in
+# percent, that settled within 1 ms of -s, from /proc/net/tcp_cesar_stat.
+# Compare it with and without -A and -G for how well SU detection holds up
+# behind ACK coalescing.
+#
+# cc defaults to "cesar bbr cubic"; tcp_cesar must already be loaded
+# (module_cesar_add.sh). "cesar-su" runs cesar with net.ipv4.tcp_cesar_su_pacing
+# set, to compare SU-aligned bursts against smooth pacing on queueing delay.
+# "cesar_bpf" is the struct_ops build, attached with bpf/cesar_bpf.
+#
+# -C adds the mean cost of one cong_control call, i.e. of one ACK, in ns:
+# ftrace's function profiler times cesar_main for the module, bpf_stats
+# times cesar_bpf_main for struct_ops. Each adds its own few tens of ns,
+# so compare "cesar" with "cesar_bpf" at the same rate, not with others.
+# Needs iproute2, iperf3 and /dev/net/tun; -C also needs bpftool.
+
+dir=$(cd "$(dirname "$0")" && pwd)
+link=$dir/cesar_link
+chunk=$dir/cesar_chunk
+
+trace=""
+rate=50
+su=5000
+jitter=200
+buffer=1000000
+base_rtt=40000
+duration=30
+seed=1
+handover=""
+mark=""
+fct_sizes=""
+fct_runs=5
+chunks=""
+ack_cost=""
+thin=""
+batch=""
+su_score=""
+tracing=/sys/kernel/tracing
+out=$(mktemp -d /tmp/cesar_bench.XXXXXX)
+
+while getopts "T:r:s:j:b:d:t:H:K:A:G:S:F:V:n:CUo:h" opt; do
+	case $opt in
+	T) trace=$OPTARG ;;
+	r) rate=$OPTARG ;;
+	s) su=$OPTARG ;;
+	j) jitter=$OPTARG ;;
+	b) buffer=$OPTARG ;;
+	d) base_rtt=$OPTARG ;;
+	t) duration=$OPTARG ;;
+	H) handover=$OPTARG ;;
+	K) mark=$OPTARG ;;
+	A) thin=$OPTARG ;;
+	G) batch=$OPTARG ;;
+	F) fct_sizes=$OPTARG ;;
+	V) chunks=$OPTARG ;;
+	n) fct_runs=$OPTARG ;;
+	C) ack_cost=1 ;;
+	U) su_score=1 ;;
+	S) seed=$OPTARG ;;
+	o) out=$OPTARG; mkdir -p "$out" ;;
+	*) sed -n '8,46p' "$0"; exit 2 ;;
+	esac
+done
+shift $((OPTIND - 1))
+ccs=${*:-cesar bbr cubic}
+
+ns=cesar-client
+srv_ip=10.64.0.1
+cli_ip=10.64.0.2
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "run as root"
+	exit 1
+fi
+
+if [ ! -x "$link" ] || [ ! -x "$chunk" ]; then
+	make -C "$dir/.." emulator || exit 1
+fi
+
+if [ -z "$trace" ]; then
+	# constant rate: bytes per 1 ms TTI
+	trace=$out/constant_${rate}mbit.trace
+	echo $((rate * 1000000 / 8 / 1000)) > "$trace"
+fi
+
+for cc in $ccs; do
+	if ! grep -qw "${cc%-su}" /proc/sys/net/ipv4/tcp_available_congestion_control; then
+		echo "$cc is not available, load it first"
+		exit 1
+	fi
+done
+
+# percentile of the numbers in $1, p in [0, 100]
+pct() {
+	sort -n "$1" | awk -v p="$2" '{ a[NR] = $1 }
+		END { if (!NR) { print "-"; exit } i = int((NR - 1) * p / 100) + 1; print a[i] }'
+}
+
+link_up() {
+	local extra=""
+
+	if [ -n "$handover" ]; then
+		extra="-H ${handover%%:*}:$((${handover##*:} / 2))"
+	fi
+	if [ -n "$mark" ]; then
+		extra="$extra -K $mark"
+	fi
+	if [ -n "$thin" ]; then
+		extra="$extra -A $thin"
+	fi
+	if [ -n "$batch" ]; then
+		extra="$extra -G $batch"
+	fi
+
+	ip netns add $ns
+	"$link" -n /var/run/netns/$ns -s "$su" -j "$jitter" -b "$buffer" \
+		-d "$((base_rtt / 2))" $extra -S "$seed" -l "$1" "$trace" 2> "$2" &
+	link_pid=$!
+
+	for _ in $(seq 50); do
+		ip link show cesar0 > /dev/null 2>&1 && break
+		sleep 0.1
+	done
+	ip addr add $srv_ip peer $cli_ip dev cesar0
+	ip link set cesar0 up txqueuelen 10000
+	ip netns exec $ns ip link set lo up
+	ip netns exec $ns ip addr add $cli_ip peer $srv_ip dev cesar1
+	ip netns exec $ns ip link set cesar1 up txqueuelen 10000
+}
+
+link_down() {
+	kill "$link_pid" 2> /dev/null
+	wait "$link_pid" 2> /dev/null
+	ip netns del $ns 2> /dev/null
+}
+
+# RTT of the busiest connection to the receiver, every 100 ms, in ms
+sample_rtt() {
+	while :; do
+		ss -tinH dst $cli_ip | awk '
+			/rtt:/ {
+				b = 0; r = ""
+				for (i = 1; i <= NF; i++) {
+					if ($i ~ /^bytes_acked:/) { split($i, x, ":"); b = x[2] }
+					if ($i ~ /^rtt:/) { split($i, x, "[:/]"); r = x[2] }
+				}
+				if (r != "" && b >= best) { best = b; rtt = r }
+			}
+			END { if (rtt != "") print rtt }'
+		sleep 0.1
+	done
+}
+
+# completion time of -n transfers per size in $fct_sizes, in ms
+run_fct() {
+	local cc=$1 size start end
+
+	ip netns exec $ns iperf3 -s -D -B $cli_ip -I "$out/$cc.iperf3.pid"
+	sleep 0.5
+	for size in $fct_sizes; do
+		: > "$out/$cc.fct_$size"
+		for _ in $(seq "$fct_runs"); do
+			start=$(date +%s%N)
+			iperf3 -c $cli_ip -C "${cc%-su}" -n "$size" > /dev/null || continue
+			end=$(date +%s%N)
+			echo $(((end - start) / 1000000)) >> "$out/$cc.fct_$size"
+			sleep 1
+		done
+		printf "%-8s %10s %8s %8s\n" "$cc" "$size" \
+			"$(pct "$out/$cc.fct_$size" 50)" "$(pct "$out/$cc.fct_$size" 95)"
+	done
+	kill "$(cat "$out/$cc.iperf3.pid")" 2> /dev/null
+}
+
+# download time of each chunk but the first, in ms
+run_chunks() {
+	local cc=$1 size=${chunks%%:*} period=${chunks##*:} sender
+
+	"$chunk" -l $srv_ip:5300 -C "${cc%-su}" &
+	sender=$!
+	sleep 0.5
+	ip netns exec $ns "$chunk" -c $srv_ip:5300 -s "$size" -i "$period" \
+		-n $((fct_runs + 1)) | tail -n +2 > "$out/$cc.chunk"
+	wait $sender
+	printf "%-8s %10s %8s %8s\n" "$cc" "$size" \
+		"$(pct "$out/$cc.chunk" 50)" "$(pct "$out/$cc.chunk" 95)"
+}
+
+# run_time_ns and run_cnt summed over every loaded cesar_bpf_main, old
+# versions included, since their connections may still be running
+bpf_prog_stats() {
+	bpftool prog show name cesar_bpf_main 2> /dev/null | awk '
+		{
+			for (i = 1; i < NF; i++) {
+				if ($i == "run_time_ns") t += $(i + 1)
+				if ($i == "run_cnt") n += $(i + 1)
+			}
+		}
+		END { print t + 0, n + 0 }'
+}
+
+ack_cost_begin() {
+	case $1 in
+	cesar|cesar-su)
+		echo cesar_main > $tracing/set_ftrace_filter
+		echo 0 > $tracing/function_profile_enabled
+		echo 1 > $tracing/function_profile_enabled
+		;;
+	*)
+		cost_base=$(bpf_prog_stats)
+		;;
+	esac
+}
+
+# ns per cong_control call since ack_cost_begin, "-" if $1 made none
+ack_cost_end() {
+	case $1 in
+	cesar|cesar-su)
+		echo 0 > $tracing/function_profile_enabled
+		cat $tracing/trace_stat/function[0-9]* 2> /dev/null | awk '
+			$1 == "cesar_main" { n += $2; t += $3 }
+			END { if (n) printf "%.0f\n", t * 1000 / n; else print "-" }'
+		: > $tracing/set_ftrace_filter
+		;;
+	*)
+		echo "$cost_base $(bpf_prog_stats)" | awk '
+			{ n = $4 - $2 }
+			END { if (n > 0) printf "%.0f\n", ($3 - $1) / n; else print "-" }'
+		;;
+	esac
+}
+
+# "lo-hi count" for every SU histogram bucket of the module's stats
+su_hist() {
+	awk '$1 == "su_us" { print $2, $3 }' /proc/net/tcp_cesar_stat 2> /dev/null
+}
+
+# percent of the SU decisions since $1 (su_hist output) within 1 ms of -s
+su_ok() {
+	su_hist | awk -v su="$su" -v base="$1" '
+		BEGIN {
+			n = split(base, b, "\n")
+			for (i = 1; i <= n; i++) { split(b[i], f, " "); old[f[1]] = f[2] }
+		}
+		{
+			d = $2 - old[$1]; split($1, r, "-")
+			all += d
+			if (r[1] <= su + 1000 && (r[2] == "" || r[2] >= su - 1000))
+				ok += d
+		}
+		END { if (all > 0) printf "%.1f\n", ok * 100 / all; else print "-" }'
+}
+
+su_pacing=$(sysctl -n net.ipv4.tcp_cesar_su_pacing 2> /dev/null | awk '{ print $1 }')
+bpf_stats=$(sysctl -n kernel.bpf_stats_enabled 2> /dev/null)
+
+trap 'link_down; kill $sampler_pid 2> /dev/null
+	[ -n "$su_pacing" ] && sysctl -qw net.ipv4.tcp_cesar_su_pacing=$su_pacing
+	[ -n "$ack_cost" ] && sysctl -qw kernel.bpf_stats_enabled=$bpf_stats' EXIT
+
+if [ -n "$ack_cost" ]; then
+	sysctl -qw kernel.bpf_stats_enabled=1
+fi
+
+if [ -n "$chunks" ]; then
+	printf "%-8s %10s %8s %8s\n" cc chunk chunk50 chunk95
+elif [ -n "$fct_sizes" ]; then
+	printf "%-8s %10s %8s %8s\n" cc size fct50 fct95
+else
+	printf "%-8s %10s %8s %8s %8s %8s %8s %8s%s%s\n" cc "Mbit/s" \
+		"rtt50" "rtt95" "rtt99" "qd50" "qd95" "qd99" \
+		"${ack_cost:+$(printf " %8s" ack_ns)}" \
+		"${su_score:+$(printf " %8s" su_ok)}"
+fi
+
+for cc in $ccs; do
+	link_up "$out/$cc.qdelay" "$out/$cc.link"
+
+	if [ "$cc" = cesar-su ]; then
+		sysctl -qw net.ipv4.tcp_cesar_su_pacing=1
+	elif [ -n "$su_pacing" ]; then
+		sysctl -qw net.ipv4.tcp_cesar_su_pacing=0
+	fi
+
+	if [ -n "$chunks" ]; then
+		run_chunks "$cc"
+		link_down
+		continue
+	fi
+	if [ -n "$fct_sizes" ]; then
+		run_fct "$cc"
+		link_down
+		continue
+	fi
+
+	ip netns exec $ns iperf3 -s -1 -D -B $cli_ip
+	sleep 0.5
+
+	sample_rtt > "$out/$cc.rtt" &
+	sampler_pid=$!
+
+	[ -n "$ack_cost" ] && ack_cost_begin "$cc"
+	su_base=$(su_hist)
+	iperf3 -c $cli_ip -C "${cc%-su}" -t "$duration" -f m > "$out/$cc.iperf"
+	mbps=$(awk '/receiver/ { print $(NF - 2) }' "$out/$cc.iperf")
+	ack_ns=""
+	[ -n "$ack_cost" ] && ack_ns=$(printf " %8s" "$(ack_cost_end "$cc")")
+	su_pct=""
+	case $cc in
+	cesar|cesar-su) [ -n "$su_score" ] && su_pct=$(printf " %8s" "$(su_ok "$su_base")") ;;
+	*) [ -n "$su_score" ] && su_pct=$(printf " %8s" -) ;;
+	esac
+
+	kill $sampler_pid 2> /dev/null
+	wait $sampler_pid 2> /dev/null
+	link_down
+
+	awk '{ print $2 / 1000 }' "$out/$cc.qdelay" > "$out/$cc.qdelay_ms"
+
+	printf "%-8s %10s %8s %8s %8s %8s %8s %8s%s%s\n" "$cc" "${mbps:--}" \
+		"$(pct "$out/$cc.rtt" 50)" "$(pct "$out/$cc.rtt" 95)" \
+		"$(pct "$out/$cc.rtt" 99)" \
+		"$(pct "$out/$cc.qdelay_ms" 50)" "$(pct "$out/$cc.qdelay_ms" 95)" \
+		"$(pct "$out/$cc.qdelay_ms" 99)" "$ack_ns" "$su_pct"
+done
+
+echo "raw data in $out (RTT, queueing delay and completion times in ms)"
@@ -0,0 +1,905 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * Userspace replay harness for tcp_cesar.c.
+ *
+ * Builds the unmodified module source against include/cesar_shim.h and
+ * drives tcp_cesar_cong_ops with a recorded trace of ACK events, printing
+ * the cwnd, pacing rate, scheduling unit and mode Cesar picks on each ACK.
+ * Nothing depends on wall-clock time or randomness, so a given trace and
+ * set of options always produces the same output.
+ *
+ * Trace format: one ACK per line, comma separated, '#' starts a comment.
+ *
+ *   time_us,delivered,interval_us,rtt_us,acked_sacked,app_limited[,losses[,ca_state[,delivered_ce]]]
+ *
+ * time_us becomes tp->tcp_mstamp, the next four fields, app_limited,
+ * losses and delivered_ce fill struct rate_sample. prior_delivered is
+ * tp->delivered as it stood rtt_us before this ACK, when the packet it
+ * acknowledges left, so rounds last an RTT as they do in the kernel.
+ * prior_delivered_ce follows the running tp->delivered_ce, and rtt_us > 0
+ * also feeds pkts_acked().
+ *
+ * ca_state is the TCP_CA_* state in effect from this ACK on. Moving into
+ * Recovery or Loss saves tp->prior_cwnd and calls set_state() the way
+ * tcp_input.c does; REPLAY_CA_UNDO calls undo_cwnd() and returns to Open.
+ * The sender is assumed cwnd limited, so packets_out follows snd_cwnd.
+ * A ca_state of -1 leaves the state alone.
+ *
+ * app_limited also sets tp->app_limited. An app-limited ACK more than its
+ * rtt_us after the one before it ends an idle period: the sender had
+ * nothing in flight and the application restarted it, so cwnd_event()
+ * gets CA_EVENT_TX_START dated rtt_us before the ACK, when the packet it
+ * acknowledges left, as tcp_event_data_sent() would raise it.
+ *
+ * Usage: cesar_replay [-m mss] [-p profile] [-a alpha] [-b beta] [-g gamma]
+ *                     [-s su] [-w bin_us] [-e] [-E] [-D] [-r repeat] [-q] [-S]
+ *                     [-t] [-c] [-f seed] [-G window_us] [-A n] [-u su]
+ *                     [-B file] [-T su[,jitter_us]] [-L acks[,pct]]
+ *                     [-F acks[,pct]] [-P lo,hi] [-W hi] [trace.csv]
+ *
+ * -p runs the flow on "cesar<profile>" and so on that parameter profile; -a,
+ * -b, -g, -s and -w override the profile's values and -e turns on its
+ * cesar_su_pacing. The sender is taken to keep up with its pacing, so
+ * tcp_wstamp_ns only runs ahead of the clock by the hold SU pacing adds.
+ * -E loads the module with cesar_ecn set. -S prints what
+ * /proc/net/tcp_cesar_stat would show after the last repeat, on stderr
+ * unless -q keeps stdout free for it.
+ *
+ * -D turns on cesar_share for the profile. Every repeat is a new flow to
+ * the same destination, so with -r 2 the second one starts from what the
+ * first left behind.
+ *
+ * -t times the replay loop and reports the mean cost of one ACK on stderr;
+ * combine with -q and a large -r for a stable figure.
+ *
+ * -c checks after every ACK what must hold whatever the trace: snd_cwnd
+ * at least cesar_cwnd_min_target, pacing within sk_max_pacing_rate and
+ * not collapsed to zero once there is a bandwidth estimate, su and the
+ * bitfields in range. The first violation is reported with the index of its
+ * ACK and the replay exits 1. -f seed first mangles the trace with a seeded
+ * generator: RTT spikes and zeros, empty or negative intervals, stretch
+ * ACKs, losses, CE marks, state changes and clock jumps. A seed always
+ * yields the same trace, so a failure reproduces with the same command:
+ *
+ *   for s in $(seq 1 1000); do cesar_replay -q -c -f $s trace.csv || echo $s; done
+ *
+ * make check runs the first 200 seeds on a -T 5000,100 trace.
+ *
+ * replay/golden/ holds the per-ACK output of two synthetic traces, which
+ * make check wants byte for byte: -T 2500,100 -e locks on su and paces by
+ * it, -T 5000,4000 has no pattern and runs the BBR fallback. A change
+ * meant to leave behaviour alone must leave them alone too; one that
+ * changes it regenerates them, e.g.
+ *
+ *   cesar_replay -T 5000,4000 > replay/golden/synth-5000-4000.csv
+ *
+ * and says why in its commit.
+ *
+ * Build with -fsanitize=address,undefined to have overflows and division
+ * by zero fail the same way.
+ *
+ * -G and -A replay the trace as a sender behind ACK coalescing would see
+ * it: -G window_us hands over every ACK that arrives within window_us of
+ * the first one of a batch as one, as GRO, LRO and interrupt moderation
+ * do; -A n keeps only every n-th ACK, as ACK thinning or a receiver sending
+ * stretch ACKs does. -u su then reports on stderr how many of the ACKs
+ * seen in STEADY had su within its margin of the link's, so a recorded or
+ * generated trace with a known SU scores the detector:
+ *
+ *   for n in 1 2 4 8 12; do cesar_replay -q -u 5000 -A $n trace.csv; done
+ *
+ * -B file loads the module with the sample capture on for every flow and
+ * writes its struct cesar_sample records to file, the same stream
+ * tools/cesar_capture saves from a live kernel; cesar_capture -p prints it.
+ *
+ * -T su,jitter_us replays a generated trace instead of a file: a bearer
+ * that grants the flow every su us, give or take jitter_us, behind a
+ * queue that what is in flight beyond the BDP fills, so RTT answers to
+ * snd_cwnd. A jitter close to su leaves no pattern for Cesar to find.
+ *
+ * The rest turn a replay into a scenario that exits 1 when Cesar misses
+ * what it asserts, printing each measure on stderr with FAIL against the
+ * ones it broke. -L acks,pct wants su locked within the -u margin by the
+ * acks-th ACK and right on pct% of the ACKs in STEADY; -F acks,pct wants
+ * the fallback to BBR by then and pct% of the ACKs after it in BBR. From
+ * the first ACK in STEADY or BBR on, -P lo,hi keeps sk_pacing_rate
+ * within lo-hi% of the trace's delivery rate and -W hi keeps snd_cwnd
+ * under hi% of its BDP at the lowest RTT. Lock and fallback are
+ * reported in ACKs and trace time, so slower convergence fails as
+ * surely as a wrong su. The scenarios that must keep passing, which
+ * make check runs:
+ *
+ *   cesar_replay -q -c -T 2500,100 -u 2500 -L 1500,95 -P 125,300 -W 200
+ *   cesar_replay -q -c -T 5000,100 -u 5000 -L 650,95 -P 125,300 -W 225
+ *   cesar_replay -q -c -T 8000,100 -u 8000 -L 450,95 -P 125,300 -W 300
+ *   cesar_replay -q -c -T 5000,4000 -F 600,75 -P 125,300 -W 350
+ */
+#include "../tcp_cesar.c"
+
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+
+u32 tcp_jiffies32;
+struct net init_net;
+int (*cesar_shim_proc_show)(struct seq_file *m, void *v);
+FILE *cesar_shim_relay_out;
+
+#define REPLAY_CA_UNDO	8
+
+struct replay_ack {
+	u64	time_us;
+	s32	delivered;
+	long	interval_us;
+	long	rtt_us;
+	u32	acked_sacked;
+	bool	app_limited;
+	int	losses;
+	int	ca_state;
+	int	delivered_ce;
+	u32	total_delivered;	/* tp->delivered after this ACK */
+};
+
+struct replay_trace {
+	struct replay_ack *acks;
+	size_t len;
+	size_t cap;
+	u32 link_pps;		/* -T: the bearer's rate, packets/s */
+	u32 link_bdp;		/* ... and its BDP at the base RTT, packets */
+};
+
+static int replay_load(FILE *in, struct replay_trace *trace)
+{
+	char line[256];
+	size_t lineno = 0;
+
+	while (fgets(line, sizeof(line), in)) {
+		struct replay_ack ack = { 0 };
+		unsigned long long time_us;
+		int app_limited = 0;
+		char *p = line;
+		int n;
+
+		lineno++;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+
+		ack.ca_state = -1;
+		n = sscanf(p, "%llu,%d,%ld,%ld,%u,%d,%d,%d,%d", &time_us,
+			   &ack.delivered, &ack.interval_us, &ack.rtt_us,
+			   &ack.acked_sacked, &app_limited, &ack.losses,
+			   &ack.ca_state, &ack.delivered_ce);
+		if (n < 6) {
+			fprintf(stderr, "line %zu: expected at least 6 fields\n",
+				lineno);
+			return -EINVAL;
+		}
+		ack.time_us = time_us;
+		ack.app_limited = app_limited;
+		ack.total_delivered = ack.delivered;
+		if (trace->len)
+			ack.total_delivered += trace->acks[trace->len - 1].total_delivered;
+
+		if (trace->len == trace->cap) {
+			size_t cap = trace->cap ? trace->cap * 2 : 4096;
+			struct replay_ack *acks;
+
+			acks = realloc(trace->acks, cap * sizeof(*acks));
+			if (!acks)
+				return -ENOMEM;
+			trace->acks = acks;
+			trace->cap = cap;
+		}
+		trace->acks[trace->len++] = ack;
+	}
+	return 0;
+}
+
+/* xorshift64*, so -f seed gives the same trace everywhere */
+static u64 replay_rand(u64 *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static long replay_rand_range(u64 *state, long lo, long hi)
+{
+	return lo + (long)(replay_rand(state) % (u64)(hi - lo + 1));
+}
+
+/* -f: perturb one ACK in four, then redo the running totals */
+static void replay_fuzz(struct replay_trace *trace, u64 seed)
+{
+	u64 state = seed * 0x9E3779B97F4A7C15ULL + 1, shift_us = 0;
+	size_t i;
+
+	for (i = 0; i < trace->len; i++) {
+		struct replay_ack *ack = &trace->acks[i];
+
+		if (replay_rand(&state) % 4) {
+			ack->time_us += shift_us;
+			goto total;
+		}
+
+		switch (replay_rand(&state) % 10) {
+		case 0:		/* RTT spike, or no sample */
+			ack->rtt_us = replay_rand_range(&state, -1, 4 * ack->rtt_us + 1000000);
+			break;
+		case 1:		/* RTT far below anything seen */
+			ack->rtt_us = replay_rand_range(&state, 1, 100);
+			break;
+		case 2:		/* empty, negative or huge interval */
+			ack->interval_us = replay_rand_range(&state, -1, 1) *
+					   (replay_rand(&state) % 2 ? 1 : 10000000);
+			break;
+		case 3:		/* stretch ACK */
+			ack->delivered = replay_rand_range(&state, -1, 2000);
+			ack->acked_sacked = replay_rand_range(&state, 0, 2000);
+			break;
+		case 4:
+			ack->losses = replay_rand_range(&state, 0, 100);
+			break;
+		case 5:
+			ack->ca_state = replay_rand_range(&state, -1, TCP_CA_Loss);
+			if (ack->ca_state == TCP_CA_CWR)
+				ack->ca_state = REPLAY_CA_UNDO;
+			break;
+		case 6:
+			ack->delivered_ce = replay_rand_range(&state, 0,
+							      max(ack->delivered, 0));
+			break;
+		case 7:
+			ack->app_limited = !ack->app_limited;
+			break;
+		case 8:		/* idle period or clock jump */
+			shift_us += replay_rand_range(&state, 0, 30000000);
+			break;
+		default:	/* everything at once */
+			ack->rtt_us = replay_rand_range(&state, 0, 3000000);
+			ack->interval_us = replay_rand_range(&state, 0, 3000000);
+			ack->delivered = replay_rand_range(&state, 0, 65535);
+			ack->acked_sacked = replay_rand_range(&state, 0, 65535);
+			break;
+		}
+		ack->time_us += shift_us;
+total:
+		ack->total_delivered = ack->delivered;
+		if (i)
+			ack->total_delivered += trace->acks[i - 1].total_delivered;
+	}
+}
+
+#define REPLAY_SYNTH_BURSTS	4000
+#define REPLAY_SYNTH_BASE_RTT	40000
+#define REPLAY_SYNTH_ACK_GAP	30
+
+/* -T: a bearer that grants the flow once every su us, give or take
+ * jitter_us, as a cellular scheduler does. Each grant comes back as a
+ * burst of 3 to 8 ACKs of 2 packets, REPLAY_SYNTH_ACK_GAP apart, whose
+ * rate samples see the grant's packets spread over the SU, and each
+ * packet waited up to an SU for its grant on top of the base RTT. The
+ * generator has a fixed seed, so a given su and jitter always yield the
+ * same trace; a jitter close to su leaves no pattern to find.
+ */
+static int replay_synth(struct replay_trace *trace, u32 su, u32 jitter_us)
+{
+	u64 state = 0x9E3779B97F4A7C15ULL, time_us = 100000;
+	size_t i, k, n = 0;
+
+	trace->cap = REPLAY_SYNTH_BURSTS * 8;
+	trace->acks = calloc(trace->cap, sizeof(*trace->acks));
+	if (!trace->acks)
+		return -ENOMEM;
+
+	for (i = 0; i < REPLAY_SYNTH_BURSTS; i++) {
+		long gap = su + replay_rand_range(&state, -(long)jitter_us, jitter_us);
+		size_t burst = replay_rand_range(&state, 3, 8);
+
+		time_us += max(gap, 100L);
+		for (k = 0; k < burst; k++) {
+			struct replay_ack *ack = &trace->acks[n++];
+
+			ack->time_us = time_us + k * REPLAY_SYNTH_ACK_GAP;
+			ack->delivered = 2;
+			ack->acked_sacked = 2;
+			ack->interval_us = su / burst;
+			ack->rtt_us = REPLAY_SYNTH_BASE_RTT +
+				      replay_rand_range(&state, 0, su);
+			ack->ca_state = -1;
+			ack->total_delivered = ack->delivered;
+			if (n > 1)
+				ack->total_delivered += trace->acks[n - 2].total_delivered;
+		}
+	}
+	trace->len = n;
+	trace->link_pps = div64_u64((u64)trace->acks[n - 1].total_delivered * USEC_PER_SEC,
+				    trace->acks[n - 1].time_us - trace->acks[0].time_us);
+	trace->link_bdp = (u64)trace->link_pps * REPLAY_SYNTH_BASE_RTT / USEC_PER_SEC;
+	return 0;
+}
+
+/* Fold ack into into, the later of the two, as one cumulative ACK would
+ * report both: counts add up, the rate sample stretches so delivered over
+ * interval_us stays what into measured.
+ */
+static void replay_merge(struct replay_ack *into, const struct replay_ack *ack)
+{
+	s32 delivered = into->delivered + ack->delivered;
+
+	if (into->delivered > 0 && into->interval_us > 0)
+		into->interval_us = (s64)into->interval_us * delivered /
+				    into->delivered;
+	into->delivered = delivered;
+	into->acked_sacked += ack->acked_sacked;
+	into->losses += ack->losses;
+	into->delivered_ce += ack->delivered_ce;
+	if (into->ca_state < 0)
+		into->ca_state = ack->ca_state;
+}
+
+/* -G and -A: ACKs arriving within window_us of the first of a batch reach
+ * the sender as one, the way GRO, LRO and interrupt moderation hand them
+ * over; -A keeps only every n-th ACK, as a thinning middlebox or a
+ * receiver sending stretch ACKs would. Either way the survivor carries
+ * what the ACKs before it acknowledged.
+ */
+static void replay_coalesce(struct replay_trace *trace, u64 window_us,
+			    unsigned long every)
+{
+	size_t i, n = 0, count = 0;
+	u64 first_us = 0;
+
+	for (i = 0; i < trace->len; i++) {
+		struct replay_ack ack = trace->acks[i];
+
+		if (count && (ack.time_us - first_us > window_us ||
+			      (every && count == every))) {
+			n++;
+			count = 0;
+		}
+		if (!count)
+			first_us = ack.time_us;
+		else
+			replay_merge(&ack, &trace->acks[n]);
+		trace->acks[n] = ack;
+		count++;
+	}
+	if (count)
+		n++;
+	trace->len = n;
+
+	for (i = 0; i < trace->len; i++) {
+		trace->acks[i].total_delivered = trace->acks[i].delivered;
+		if (i)
+			trace->acks[i].total_delivered += trace->acks[i - 1].total_delivered;
+	}
+}
+
+static void replay_sock_init(struct tcp_sock *tp, u32 mss, u32 profile)
+{
+	struct sock *sk = (struct sock *)tp;
+
+	memset(tp, 0, sizeof(*tp));
+	sk->sk_family = AF_INET;
+	sk->sk_daddr = htonl(INADDR_LOOPBACK);
+	sk->sk_max_pacing_rate = ~0UL;
+	sk->sk_pacing_shift = 10;
+	sk->sk_gso_max_size = GSO_MAX_SIZE;	/* a legacy 64 KB device */
+	tp->inet_conn.icsk_inet.inet_sport = htons(5201);
+	tp->inet_conn.icsk_inet.inet_dport = htons(40000);
+	tp->advmss = mss;
+	tp->mss_cache = mss;
+	tp->snd_cwnd = TCP_INIT_CWND;
+	tp->snd_cwnd_clamp = ~0U;
+	tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
+
+	/* as tcp_set_congestion_control() would for "cesar<profile>" */
+	tp->inet_conn.icsk_ca_ops = &tcp_cesar_cong_ops[profile];
+	inet_csk(sk)->icsk_ca_ops->init(sk);
+}
+
+static void replay_ca_state(struct tcp_sock *tp, int state)
+{
+	struct sock *sk = (struct sock *)tp;
+	u8 old = tp->inet_conn.icsk_ca_state;
+
+	if (state < 0 || state == old)
+		return;
+
+	if (state == REPLAY_CA_UNDO) {
+		tp->snd_cwnd = inet_csk(sk)->icsk_ca_ops->undo_cwnd(sk);
+		state = TCP_CA_Open;
+	} else if (state >= TCP_CA_Recovery && old < TCP_CA_Recovery) {
+		tp->prior_cwnd = tp->snd_cwnd;
+		tp->snd_ssthresh = inet_csk(sk)->icsk_ca_ops->ssthresh(sk);
+		if (state == TCP_CA_Loss)
+			tp->snd_cwnd = tcp_packets_in_flight(tp) + 1;
+	}
+
+	tp->inet_conn.icsk_ca_state = state;
+	inet_csk(sk)->icsk_ca_ops->set_state(sk, state);
+}
+
+/* tp->delivered as of time_us, from the ACKs before acks[i] */
+static u32 replay_delivered_at(const struct replay_trace *trace, size_t i,
+			       u64 time_us)
+{
+	size_t lo = 0, hi = i;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (trace->acks[mid].time_us <= time_us)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo ? trace->acks[lo - 1].total_delivered : 0;
+}
+
+static void replay_ack(struct tcp_sock *tp, const struct replay_trace *trace,
+		       size_t i)
+{
+	const struct replay_ack *ack = &trace->acks[i];
+	struct sock *sk = (struct sock *)tp;
+	struct rate_sample rs = { 0 };
+	long rtt_us = ack->rtt_us;
+
+	tp->app_limited = ack->app_limited;
+	if (ack->app_limited && i && ack->rtt_us > 0 &&
+	    ack->time_us > (u64)ack->rtt_us &&
+	    ack->time_us - ack->rtt_us > trace->acks[i - 1].time_us) {
+		tp->tcp_mstamp = ack->time_us - ack->rtt_us;
+		tp->tcp_clock_cache = tp->tcp_mstamp * NSEC_PER_USEC;
+		tcp_jiffies32 = tp->tcp_mstamp / 1000;
+		inet_csk(sk)->icsk_ca_ops->cwnd_event(sk, CA_EVENT_TX_START);
+	}
+
+	tp->tcp_mstamp = ack->time_us;
+	tp->tcp_clock_cache = ack->time_us * NSEC_PER_USEC;
+	tp->tcp_wstamp_ns = max(tp->tcp_wstamp_ns, tp->tcp_clock_cache);
+	tcp_jiffies32 = ack->time_us / 1000;
+	tp->delivered += ack->delivered;
+	tp->delivered_ce += ack->delivered_ce;
+	tp->bytes_acked += (u64)ack->acked_sacked * tp->mss_cache;
+	tp->packets_out = tp->snd_cwnd;
+	replay_ca_state(tp, ack->ca_state);
+
+	/* -T: what is in flight beyond the BDP queues at the bearer */
+	if (trace->link_pps && rtt_us > 0 && tp->packets_out > trace->link_bdp)
+		rtt_us += (u64)(tp->packets_out - trace->link_bdp) * USEC_PER_SEC /
+			  trace->link_pps;
+
+	if (rtt_us > 0) {
+		struct ack_sample sample = {
+			.pkts_acked = ack->acked_sacked,
+			.rtt_us = rtt_us,
+		};
+
+		inet_csk(sk)->icsk_ca_ops->pkts_acked(sk, &sample);
+	}
+
+	rs.prior_delivered = tp->delivered - ack->delivered;
+	if (rtt_us > 0 && ack->time_us > (u64)rtt_us)
+		rs.prior_delivered = replay_delivered_at(trace, i,
+							 ack->time_us - rtt_us);
+	rs.delivered = ack->delivered;
+	rs.interval_us = ack->interval_us;
+	rs.rtt_us = rtt_us;
+	rs.acked_sacked = ack->acked_sacked;
+	rs.is_app_limited = ack->app_limited;
+	rs.losses = ack->losses;
+	rs.delivered_ce = ack->delivered_ce;
+	rs.prior_delivered_ce = tp->delivered_ce - ack->delivered_ce;
+
+	inet_csk(sk)->icsk_ca_ops->cong_control(sk, 0, 0, &rs);
+}
+
+static void replay_print(FILE *out, const struct tcp_sock *tp)
+{
+	const struct sock *sk = (const struct sock *)tp;
+	const struct cesar *cesar = inet_csk_ca(sk);
+
+	fprintf(out, "%llu,%u,%lu,%u,%u,%u,%u,%u,%u,%u,%u\n",
+		(unsigned long long)tp->tcp_mstamp, tp->snd_cwnd,
+		sk->sk_pacing_rate, cesar->su, cesar->mode, cesar->cwnd_est,
+		cesar->min_rtt_us, cesar->ewma_bw, cesar->pacing_gain,
+		cesar->su_confidence, cesar_min_tso_segs((struct sock *)sk));
+}
+
+/* -c: NULL, or the first invariant the flow breaks */
+static const char *replay_check(const struct tcp_sock *tp)
+{
+	const struct sock *sk = (const struct sock *)tp;
+	const struct cesar *cesar = inet_csk_ca(sk);
+
+	if (tp->snd_cwnd < cesar_cwnd_min_target)
+		return "snd_cwnd below cesar_cwnd_min_target";
+	if (tp->snd_cwnd > tp->snd_cwnd_clamp)
+		return "snd_cwnd above snd_cwnd_clamp";
+	if (sk->sk_pacing_rate > sk->sk_max_pacing_rate)
+		return "pacing rate above sk_max_pacing_rate";
+	if (!sk->sk_pacing_rate && cesar_max_bw(sk))
+		return "pacing rate 0 with a bandwidth estimate";
+	if (cesar->mode >= CESAR_NR_MODES)
+		return "mode out of range";
+	if (!cesar->pacing_gain)
+		return "pacing_gain 0";
+	if (cesar->su <= cesar_su_margin(cesar))
+		return "su within its own margin";
+	if (cesar->pattern_bin_shift > PATTERN_BIN_SHIFT_MAX)
+		return "pattern_bin_shift past PATTERN_BIN_SHIFT_MAX";
+	if (cesar->pattern_count > PATTERN_DECISION_PERIOD)
+		return "pattern_count past PATTERN_DECISION_PERIOD";
+	if (!cesar->min_rtt_us)
+		return "min_rtt_us 0";
+	return NULL;
+}
+
+/* -u, -L, -F, -P and -W: how the first flow did against what the trace
+ * should make of it. Bounds apply from the first ACK in STEADY or BBR on,
+ * rates and windows against the link: the trace's delivery rate, and its
+ * BDP at the lowest RTT in it.
+ */
+struct replay_expect {
+	u32	true_su;		/* -u */
+	size_t	lock_by;		/* -L: su locked by this ACK */
+	u32	lock_pct;		/* ... and right on this share of STEADY */
+	size_t	bbr_by;			/* -F: in BBR by this ACK */
+	u32	bbr_pct;		/* ... and this share of the ACKs after */
+	u32	pacing_lo, pacing_hi;	/* -P, in % of the link rate */
+	u32	cwnd_hi;		/* -W, in % of the BDP */
+
+	u64	link_bps, link_bdp;	/* bytes/s, packets */
+	u64	hits, steady;
+	size_t	settled, lock, bbr, bbr_after, acks_after;
+	u64	pacing_min, pacing_max;
+	u32	cwnd_max;
+};
+
+static void replay_expect_link(struct replay_expect *e,
+			       const struct replay_trace *trace, u32 mss)
+{
+	u64 span_us, pps;
+	long min_rtt = 0;
+	size_t i;
+
+	if (trace->len < 2)
+		return;
+	span_us = trace->acks[trace->len - 1].time_us - trace->acks[0].time_us;
+	if (!span_us)
+		return;
+	pps = div64_u64((u64)trace->acks[trace->len - 1].total_delivered *
+			USEC_PER_SEC, span_us);
+	for (i = 0; i < trace->len; i++)
+		if (trace->acks[i].rtt_us > 0 &&
+		    (!min_rtt || trace->acks[i].rtt_us < min_rtt))
+			min_rtt = trace->acks[i].rtt_us;
+	e->link_bps = pps * mss;
+	e->link_bdp = pps * min_rtt / USEC_PER_SEC;
+}
+
+static void replay_score(const struct tcp_sock *tp, struct replay_expect *e,
+			 size_t i)
+{
+	const struct sock *sk = (const struct sock *)tp;
+	const struct cesar *cesar = inet_csk_ca(sk);
+	bool locked = false;
+
+	if (cesar->mode == CESAR_STEADY && e->true_su) {
+		e->steady++;
+		locked = abs(cesar->su - e->true_su) <= cesar_su_margin(cesar);
+		e->hits += locked;
+	}
+	if (locked && !e->lock)
+		e->lock = i + 1;
+	if (cesar->mode == CESAR_BBR && !e->bbr)
+		e->bbr = i + 1;
+	if (e->bbr) {
+		e->acks_after++;
+		e->bbr_after += cesar->mode == CESAR_BBR;
+	}
+
+	if (cesar->mode != CESAR_STEADY && cesar->mode != CESAR_BBR && !e->settled)
+		return;
+	if (!e->settled) {
+		e->settled = i + 1;
+		e->pacing_min = ~0ULL;
+	}
+	e->pacing_min = min_t(u64, e->pacing_min, sk->sk_pacing_rate);
+	e->pacing_max = max_t(u64, e->pacing_max, sk->sk_pacing_rate);
+	e->cwnd_max = max(e->cwnd_max, tp->snd_cwnd);
+}
+
+/* One line on stderr per measure, ending in FAIL for each broken bound;
+ * returns how many broke.
+ */
+static int replay_verdict(const struct replay_expect *e,
+			  const struct replay_trace *trace)
+{
+	u32 pacing_lo = e->link_bps ? e->pacing_min * 100 / e->link_bps : 0;
+	u32 pacing_hi = e->link_bps ? e->pacing_max * 100 / e->link_bps : 0;
+	u32 cwnd_hi = e->link_bdp ? e->cwnd_max * 100 / e->link_bdp : 0;
+	u32 lock_pct = e->steady ? e->hits * 100 / e->steady : 0;
+	u32 bbr_pct = e->acks_after ? e->bbr_after * 100 / e->acks_after : 0;
+	int fails = 0;
+	bool fail;
+
+	if (e->true_su)
+		fprintf(stderr, "%zu acks, %llu in steady, su within margin of %u us on %.1f%% of those\n",
+			trace->len, (unsigned long long)e->steady, e->true_su,
+			e->steady ? 100.0 * e->hits / e->steady : 0.0);
+	if (e->lock_by) {
+		fail = !e->lock || e->lock > e->lock_by || lock_pct < e->lock_pct;
+		fprintf(stderr, "su %u locked at ack %zu (%.1f ms), by %zu wanted, right on %u%% of steady, %u%% wanted%s\n",
+			e->true_su, e->lock,
+			e->lock ? (trace->acks[e->lock - 1].time_us - trace->acks[0].time_us) / 1000.0 : 0.0,
+			e->lock_by, lock_pct, e->lock_pct, fail ? ": FAIL" : "");
+		fails += fail;
+	}
+	if (e->bbr_by) {
+		fail = !e->bbr || e->bbr > e->bbr_by || bbr_pct < e->bbr_pct;
+		fprintf(stderr, "bbr from ack %zu (%.1f ms), by %zu wanted, in it for %u%% after, %u%% wanted%s\n",
+			e->bbr,
+			e->bbr ? (trace->acks[e->bbr - 1].time_us - trace->acks[0].time_us) / 1000.0 : 0.0,
+			e->bbr_by, bbr_pct, e->bbr_pct, fail ? ": FAIL" : "");
+		fails += fail;
+	}
+	if (e->pacing_hi) {
+		fail = !e->settled || pacing_lo < e->pacing_lo || pacing_hi > e->pacing_hi;
+		fprintf(stderr, "pacing %u-%u%% of the link's %llu B/s from ack %zu, %u-%u%% wanted%s\n",
+			pacing_lo, pacing_hi, (unsigned long long)e->link_bps,
+			e->settled, e->pacing_lo, e->pacing_hi, fail ? ": FAIL" : "");
+		fails += fail;
+	}
+	if (e->cwnd_hi) {
+		fail = !e->settled || cwnd_hi > e->cwnd_hi;
+		fprintf(stderr, "snd_cwnd up to %u%% of the link's %llu packet BDP from ack %zu, %u%% allowed%s\n",
+			cwnd_hi, (unsigned long long)e->link_bdp, e->settled,
+			e->cwnd_hi, fail ? ": FAIL" : "");
+		fails += fail;
+	}
+	return fails;
+}
+
+static u64 replay_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-m mss] [-p profile] [-a alpha] [-b beta] [-g gamma]\n"
+		"       %*s [-s su] [-w bin_us] [-e] [-E] [-D] [-r repeat] [-q] [-S] [-t]\n"
+		"       %*s [-c] [-f seed] [-G window_us] [-A n] [-u su] [-B file]\n"
+		"       %*s [-T su[,jitter_us]] [-L acks[,pct]] [-F acks[,pct]]\n"
+		"       %*s [-P lo,hi] [-W hi] [trace.csv]\n",
+		prog, (int)strlen(prog), "", (int)strlen(prog), "",
+		(int)strlen(prog), "", (int)strlen(prog), "");
+}
+
+int main(int argc, char **argv)
+{
+	struct replay_trace trace = { 0 };
+	struct tcp_sock tp;
+	unsigned long repeat = 1, r;
+	bool quiet = false, timed = false, su_pacing = false, stats = false;
+	bool share = false, check = false;
+	struct replay_expect expect = { 0 };
+	u64 seed = 0, window_us = 0;
+	unsigned long every = 0;
+	u64 start_ns, elapsed_ns;
+	u32 mss = 1448, profile = 0;
+	long alpha = -1, beta = -1, gamma = -1, su = -1, bin_us = -1;
+	const char *capture = NULL;
+	u32 synth_su = 0, synth_jitter = 0;
+	char *end;
+	FILE *in = stdin;
+	const char *what;
+	size_t i;
+	int opt, err, fails;
+
+	while ((opt = getopt(argc, argv, "m:p:a:b:g:s:w:eEDr:qStcf:G:A:u:B:T:L:F:P:W:h")) != -1) {
+		switch (opt) {
+		case 'm':
+			mss = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			profile = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			alpha = strtol(optarg, NULL, 0);
+			break;
+		case 'b':
+			beta = strtol(optarg, NULL, 0);
+			break;
+		case 'g':
+			gamma = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			su = strtol(optarg, NULL, 0);
+			break;
+		case 'w':
+			bin_us = strtol(optarg, NULL, 0);
+			break;
+		case 'e':
+			su_pacing = true;
+			break;
+		case 'E':
+			cesar_ecn = true;
+			break;
+		case 'D':
+			share = true;
+			break;
+		case 'r':
+			repeat = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			quiet = true;
+			break;
+		case 'S':
+			stats = true;
+			break;
+		case 't':
+			timed = true;
+			break;
+		case 'c':
+			check = true;
+			break;
+		case 'f':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'G':
+			window_us = strtoull(optarg, NULL, 0);
+			break;
+		case 'A':
+			every = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			expect.true_su = strtoul(optarg, NULL, 0);
+			break;
+		case 'L':
+			expect.lock_by = strtoul(optarg, &end, 0);
+			if (*end == ',')
+				expect.lock_pct = strtoul(end + 1, NULL, 0);
+			break;
+		case 'F':
+			expect.bbr_by = strtoul(optarg, &end, 0);
+			if (*end == ',')
+				expect.bbr_pct = strtoul(end + 1, NULL, 0);
+			break;
+		case 'P':
+			expect.pacing_lo = strtoul(optarg, &end, 0);
+			if (*end == ',')
+				expect.pacing_hi = strtoul(end + 1, NULL, 0);
+			break;
+		case 'W':
+			expect.cwnd_hi = strtoul(optarg, NULL, 0);
+			break;
+		case 'B':
+			capture = optarg;
+			break;
+		case 'T':
+			synth_su = strtoul(optarg, &end, 0);
+			if (*end == ',')
+				synth_jitter = strtoul(end + 1, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	if (!mss || !repeat || profile >= CESAR_NR_PROFILES || !gamma ||
+	    (expect.lock_by && !expect.true_su)) {
+		usage(argv[0]);
+		return 2;
+	}
+	if (alpha >= 0)
+		cesar_init_params.alpha[profile] = alpha;
+	if (beta >= 0)
+		cesar_init_params.beta[profile] = beta;
+	if (gamma > 0)
+		cesar_init_params.gamma[profile] = gamma;
+	if (su >= 0)
+		cesar_init_params.scheduling_unit[profile] = su;
+	if (bin_us > 0)
+		cesar_init_params.pattern_bin_us[profile] = bin_us;
+	if (su_pacing)
+		cesar_init_params.su_pacing[profile] = 1;
+	if (share)
+		cesar_init_params.share[profile] = 1;
+
+	if (synth_su) {
+		err = replay_synth(&trace, synth_su, synth_jitter);
+	} else {
+		if (optind < argc && strcmp(argv[optind], "-")) {
+			in = fopen(argv[optind], "r");
+			if (!in) {
+				perror(argv[optind]);
+				return 1;
+			}
+		}
+		err = replay_load(in, &trace);
+		if (in != stdin)
+			fclose(in);
+	}
+	if (err) {
+		fprintf(stderr, "failed to load trace: %s\n", strerror(-err));
+		return 1;
+	}
+	if (window_us || every)
+		replay_coalesce(&trace, window_us ?: ~0ULL, every);
+	if (seed)
+		replay_fuzz(&trace, seed);
+	replay_expect_link(&expect, &trace, mss);
+
+	if (capture) {
+		cesar_shim_relay_out = fopen(capture, "w");
+		if (!cesar_shim_relay_out) {
+			perror(capture);
+			return 1;
+		}
+		cesar_capture_kb = 1;
+		cesar_capture_port = -1;
+	}
+
+	err = cesar_shim_module_init();
+	if (err) {
+		fprintf(stderr, "module init failed: %s\n", strerror(-err));
+		return 1;
+	}
+
+	if (!quiet)
+		printf("time_us,snd_cwnd,pacing_rate,su,mode,cwnd_est,min_rtt_us,ewma_bw,pacing_gain,su_confidence,tso_segs\n");
+
+	start_ns = replay_now_ns();
+	for (r = 0; r < repeat; r++) {
+		replay_sock_init(&tp, mss, profile);
+		for (i = 0; i < trace.len; i++) {
+			replay_ack(&tp, &trace, i);
+			if (!quiet && r == 0)
+				replay_print(stdout, &tp);
+			if (r == 0)
+				replay_score(&tp, &expect, i);
+			if (check && (what = replay_check(&tp))) {
+				fprintf(stderr, "ack %zu (repeat %lu): %s\n", i, r, what);
+				replay_print(stderr, &tp);
+				return 1;
+			}
+		}
+		tp.inet_conn.icsk_ca_ops->release((struct sock *)&tp);
+	}
+	elapsed_ns = replay_now_ns() - start_ns;
+
+	if (timed && trace.len)
+		fprintf(stderr, "%zu acks x %lu: %.1f ns/ack\n", trace.len, repeat,
+			(double)elapsed_ns / ((double)trace.len * repeat));
+
+	fails = replay_verdict(&expect, &trace);
+
+	if (stats && cesar_shim_proc_show) {
+		struct seq_file seq = {
+			.out = quiet ? stdout : stderr,
+			.net = &init_net,
+		};
+
+		cesar_shim_proc_show(&seq, NULL);
+	}
+
+	cesar_shim_module_exit();
+	if (cesar_shim_relay_out && fclose(cesar_shim_relay_out)) {
+		perror(capture);
+		return 1;
+	}
+	free(trace.acks);
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,751 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/*
+ * Just enough of the kernel to compile tcp_cesar.c in userspace for the
+ * replay harness. Every kernel header tcp_cesar.c includes resolves to a
+ * stub under replay/include/ that pulls in this file.
+ *
+ * Layouts only model the fields Cesar touches; they are not ABI
+ * compatible with the kernel.
+ */
+#ifndef _CESAR_SHIM_H
+#define _CESAR_SHIM_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef uint16_t __be16;
+typedef uint32_t __be32;
+typedef uint8_t __u8;
+typedef uint16_t __u16;
+typedef uint32_t __u32;
+typedef unsigned long long __u64;
+typedef int32_t __s32;
+typedef unsigned short umode_t;
+
+#define __read_mostly
+#define __init
+#define __exit
+#define __net_init
+#define __net_exit
+#define __always_unused		__attribute__((unused))
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+#define BITS_PER_BYTE		8
+#define U8_MAX			((u8)~0U)
+#define U16_MAX			((u16)~0U)
+#define U32_MAX			((u32)~0U)
+#define USEC_PER_SEC		1000000UL
+#define NSEC_PER_USEC		1000UL
+#define HZ			1000
+
+/* the kernel API the shim follows, see struct tcp_congestion_ops */
+#define KERNEL_VERSION(a, b, c)	(((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE	KERNEL_VERSION(6, 10, 0)
+
+#define BUILD_BUG_ON(cond)	_Static_assert(!(cond), #cond)
+#define BUILD_BUG_ON_ZERO(e)	((int)(sizeof(struct { int:(-!!(e)); })))
+#define __same_type(a, b)	__builtin_types_compatible_p(typeof(a), typeof(b))
+#define __must_be_array(a)	BUILD_BUG_ON_ZERO(__same_type((a), &(a)[0]))
+#define IS_ENABLED(option)	0
+#define container_of(ptr, type, member)	\
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#define sizeof_field(T, m)	sizeof(((T *)0)->m)
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]) + __must_be_array(a))
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+
+#define min(a, b)		({ typeof(a) __a = (a); typeof(b) __b = (b); __a < __b ? __a : __b; })
+#define max(a, b)		({ typeof(a) __a = (a); typeof(b) __b = (b); __a > __b ? __a : __b; })
+#define min_t(t, a, b)		({ t __a = (a); t __b = (b); __a < __b ? __a : __b; })
+#define max_t(t, a, b)		({ t __a = (a); t __b = (b); __a > __b ? __a : __b; })
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+
+/* Like the kernel's abs(): integer types are converted to their signed
+ * counterpart first, so abs(u32 - u32) is a distance, not a no-op.
+ */
+#define __abs_choose_expr(x, type, other) __builtin_choose_expr(	\
+	__builtin_types_compatible_p(typeof(x), signed type) ||		\
+	__builtin_types_compatible_p(typeof(x), unsigned type),		\
+	({ signed type __x = (x); __x < 0 ? -__x : __x; }), other)
+#define abs(x)	__abs_choose_expr(x, long long,				\
+		__abs_choose_expr(x, long,				\
+		__abs_choose_expr(x, int,				\
+		__abs_choose_expr(x, short,				\
+		__abs_choose_expr(x, char, (void)0)))))
+
+/* asm-generic do_div(): divides n in place, evaluates to the remainder. */
+#define do_div(n, base) ({					\
+	u32 __base = (base);					\
+	u32 __rem = (u64)(n) % __base;				\
+	(n) = (u64)(n) / __base;				\
+	__rem;							\
+})
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+	return dividend / divisor;
+}
+
+#define cmpxchg(ptr, old, new)	__sync_val_compare_and_swap(ptr, old, new)
+#define READ_ONCE(x)		(*(volatile typeof(x) *)&(x))
+#define WRITE_ONCE(x, val)	(*(volatile typeof(x) *)&(x) = (val))
+
+#define printk(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define KERN_WARNING		""
+#define KERN_INFO		""
+
+/* Modules: parameters stay plain globals the harness may overwrite. */
+struct module;
+#define THIS_MODULE			((struct module *)0)
+#define module_param(name, type, perm)
+#define module_param_array(name, type, nump, perm)
+#define module_param_array_named(name, array, type, nump, perm)
+#define MODULE_PARM_DESC(name, desc)
+#define MODULE_AUTHOR(x)
+#define MODULE_LICENSE(x)
+#define MODULE_DESCRIPTION(x)
+#define module_init(fn)		int (*cesar_shim_module_init)(void) = fn
+#define module_exit(fn)		void (*cesar_shim_module_exit)(void) = fn
+
+/* Memory */
+#define GFP_KERNEL		0
+#define GFP_ATOMIC		0
+
+static inline void *kzalloc(size_t len, int gfp)
+{
+	(void)gfp;
+	return calloc(1, len);
+}
+
+static inline void *kmemdup(const void *src, size_t len, int gfp)
+{
+	void *p = malloc(len);
+
+	(void)gfp;
+	return p ? memcpy(p, src, len) : NULL;
+}
+
+#define kfree(p)		free(p)
+#define kfree_rcu(p, field)	free(p)
+
+/* Locking: the harness is single threaded, so locks and RCU are no-ops
+ * and atomics plain integers.
+ */
+typedef struct {
+	int	locked;
+} spinlock_t;
+
+#define spin_lock_init(l)	((l)->locked = 0)
+#define spin_lock_bh(l)		((void)(l))
+#define spin_unlock_bh(l)	((void)(l))
+#define rcu_read_lock()		do { } while (0)
+#define rcu_read_unlock()	do { } while (0)
+
+struct rcu_head {
+	void	*next;
+};
+
+typedef struct {
+	int	counter;
+} atomic_t;
+
+#define atomic_read(v)		((v)->counter)
+#define atomic_inc_return(v)	(++(v)->counter)
+#define atomic_dec(v)		((void)(v)->counter--)
+
+typedef struct {
+	s64	counter;
+} atomic64_t;
+
+#define atomic64_read(v)	((v)->counter)
+
+/* hlist and the fixed-size hash table on top of it, linux/hashtable.h */
+struct hlist_node {
+	struct hlist_node	*next, **pprev;
+};
+
+struct hlist_head {
+	struct hlist_node	*first;
+};
+
+static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
+{
+	n->next = h->first;
+	if (h->first)
+		h->first->pprev = &n->next;
+	h->first = n;
+	n->pprev = &h->first;
+}
+
+static inline void hlist_del(struct hlist_node *n)
+{
+	*n->pprev = n->next;
+	if (n->next)
+		n->next->pprev = n->pprev;
+}
+
+#define hlist_entry_safe(ptr, type, member) ({				\
+	typeof(ptr) ____ptr = (ptr);					\
+	____ptr ? container_of(____ptr, type, member) : NULL;		\
+})
+
+#define hlist_for_each_entry(pos, head, member)				\
+	for (pos = hlist_entry_safe((head)->first, typeof(*(pos)), member); \
+	     pos;							\
+	     pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+
+#define hlist_for_each_entry_safe(pos, n, head, member)			\
+	for (pos = hlist_entry_safe((head)->first, typeof(*(pos)), member); \
+	     pos && ({ n = (pos)->member.next; 1; });			\
+	     pos = hlist_entry_safe(n, typeof(*(pos)), member))
+
+#define DECLARE_HASHTABLE(name, bits)	struct hlist_head name[1 << (bits)]
+#define HASH_SIZE(name)			ARRAY_SIZE(name)
+/* hash_64() from linux/hash.h, for the table's bits */
+#define hash_bucket(name, key)						\
+	(unsigned int)(((u64)(key) * 0x61C8864680B583EBULL) >>		\
+		       (64 - __builtin_ctz(HASH_SIZE(name))))
+
+#define hash_init(name)			memset(name, 0, sizeof(name))
+#define hash_add_rcu(name, node, key)					\
+	hlist_add_head(node, &(name)[hash_bucket(name, key)])
+#define hash_del_rcu(node)		hlist_del(node)
+#define hash_for_each_possible_rcu(name, obj, member, key)		\
+	hlist_for_each_entry(obj, &(name)[hash_bucket(name, key)], member)
+#define hash_for_each_possible_safe(name, obj, tmp, member, key)	\
+	hlist_for_each_entry_safe(obj, tmp, &(name)[hash_bucket(name, key)], member)
+#define hash_for_each_safe(name, bkt, tmp, obj, member)			\
+	for ((bkt) = 0, obj = NULL; !obj && (bkt) < (int)HASH_SIZE(name); (bkt)++) \
+		hlist_for_each_entry_safe(obj, tmp, &(name)[bkt], member)
+
+/* Per-CPU data: the harness is a single CPU */
+#define __percpu
+#define alloc_percpu(type)	((type *)calloc(1, sizeof(type)))
+#define free_percpu(p)		free(p)
+#define per_cpu_ptr(p, cpu)	((void)(cpu), (p))
+#define DEFINE_PER_CPU(type, name)	type name
+#define per_cpu(var, cpu)	(*((void)(cpu), &(var)))
+#define this_cpu_inc(x)		((x)++)
+#define for_each_possible_cpu(cpu)	for ((cpu) = 0; (cpu) < 1; (cpu)++)
+
+/* win_minmax, as in lib/win_minmax.c */
+struct minmax_sample {
+	u32	t;
+	u32	v;
+};
+
+struct minmax {
+	struct minmax_sample s[3];
+};
+
+static inline u32 minmax_get(const struct minmax *m)
+{
+	return m->s[0].v;
+}
+
+static inline u32 minmax_reset(struct minmax *m, u32 t, u32 meas)
+{
+	struct minmax_sample val = { .t = t, .v = meas };
+
+	m->s[2] = m->s[1] = m->s[0] = val;
+	return m->s[0].v;
+}
+
+static inline u32 minmax_subwin_update(struct minmax *m, u32 win,
+				       const struct minmax_sample *val)
+{
+	u32 dt = val->t - m->s[0].t;
+
+	if (unlikely(dt > win)) {
+		m->s[0] = m->s[1];
+		m->s[1] = m->s[2];
+		m->s[2] = *val;
+		if (unlikely(val->t - m->s[0].t > win)) {
+			m->s[0] = m->s[1];
+			m->s[1] = m->s[2];
+			m->s[2] = *val;
+		}
+	} else if (unlikely(m->s[1].t == m->s[0].t) && dt > win / 4) {
+		m->s[2] = m->s[1] = *val;
+	} else if (unlikely(m->s[2].t == m->s[1].t) && dt > win / 2) {
+		m->s[2] = *val;
+	}
+	return m->s[0].v;
+}
+
+static inline u32 minmax_running_max(struct minmax *m, u32 win, u32 t, u32 meas)
+{
+	struct minmax_sample val = { .t = t, .v = meas };
+
+	if (unlikely(val.v >= m->s[0].v) ||
+	    unlikely(val.t - m->s[2].t > win))
+		return minmax_reset(m, t, meas);
+
+	if (unlikely(val.v >= m->s[1].v))
+		m->s[2] = m->s[1] = val;
+	else if (unlikely(val.v >= m->s[2].v))
+		m->s[2] = val;
+
+	return minmax_subwin_update(m, win, &val);
+}
+
+static inline u32 minmax_running_min(struct minmax *m, u32 win, u32 t, u32 meas)
+{
+	struct minmax_sample val = { .t = t, .v = meas };
+
+	if (unlikely(val.v <= m->s[0].v) ||
+	    unlikely(val.t - m->s[2].t > win))
+		return minmax_reset(m, t, meas);
+
+	if (unlikely(val.v <= m->s[1].v))
+		m->s[2] = m->s[1] = val;
+	else if (unlikely(val.v <= m->s[2].v))
+		m->s[2] = val;
+
+	return minmax_subwin_update(m, win, &val);
+}
+
+/* The harness advances this from the trace timestamps, HZ is 1000. */
+extern u32 tcp_jiffies32;
+#define jiffies			((unsigned long)tcp_jiffies32)
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+
+/* Network namespaces: the harness only ever has init_net, which it
+ * defines, and net_generic() has a single slot.
+ */
+struct proc_dir_entry;
+
+struct net {
+	void			*gen;
+	struct proc_dir_entry	*proc_net;
+};
+
+extern struct net init_net;
+
+static inline bool net_eq(const struct net *a, const struct net *b)
+{
+	return a == b;
+}
+
+static inline void *net_generic(const struct net *net, unsigned int id)
+{
+	(void)id;
+	return net->gen;
+}
+
+struct pernet_operations {
+	int (*init)(struct net *net);
+	void (*exit)(struct net *net);
+	unsigned int *id;
+	size_t size;
+};
+
+static inline int register_pernet_subsys(struct pernet_operations *ops)
+{
+	int err;
+
+	init_net.gen = calloc(1, ops->size);
+	if (!init_net.gen)
+		return -ENOMEM;
+	*ops->id = 0;
+	err = ops->init(&init_net);
+	if (err) {
+		free(init_net.gen);
+		init_net.gen = NULL;
+	}
+	return err;
+}
+
+static inline void unregister_pernet_subsys(struct pernet_operations *ops)
+{
+	ops->exit(&init_net);
+	free(init_net.gen);
+	init_net.gen = NULL;
+}
+
+/* sysctl: tables are registered but never read or written */
+struct ctl_table {
+	const char	*procname;
+	void		*data;
+	int		maxlen;
+	unsigned short	mode;
+	int		(*proc_handler)(void);
+	void		*extra1;
+	void		*extra2;
+};
+
+struct ctl_table_header {
+	struct ctl_table	*ctl_table_arg;
+};
+
+static const int cesar_shim_sysctl_vals[] = { 0, 1 };
+#define SYSCTL_ZERO		((void *)&cesar_shim_sysctl_vals[0])
+#define SYSCTL_ONE		((void *)&cesar_shim_sysctl_vals[1])
+
+static inline int proc_dointvec_minmax(void)
+{
+	return 0;
+}
+
+static inline struct ctl_table_header *
+register_net_sysctl_sz(struct net *net, const char *path,
+		       struct ctl_table *table, size_t table_size)
+{
+	struct ctl_table_header *hdr;
+	size_t i;
+
+	/* 6.11+ refuses a table with an entry that has no procname */
+	for (i = 0; i < table_size; i++)
+		if (!table[i].procname)
+			return NULL;
+
+	hdr = calloc(1, sizeof(*hdr));
+	(void)net;
+	(void)path;
+	if (hdr)
+		hdr->ctl_table_arg = table;
+	return hdr;
+}
+
+/* As in include/net/net_namespace.h since 6.6: the table must be an array */
+#define register_net_sysctl(net, path, table)	\
+	register_net_sysctl_sz(net, path, table, ARRAY_SIZE(table))
+
+static inline void unregister_net_sysctl_table(struct ctl_table_header *hdr)
+{
+	free(hdr);
+}
+
+/* procfs: the harness keeps the one show callback and prints it on demand */
+struct seq_file {
+	FILE		*out;
+	struct net	*net;
+};
+
+#define seq_printf(m, fmt, ...)	fprintf((m)->out, fmt, ##__VA_ARGS__)
+
+static inline struct net *seq_file_single_net(struct seq_file *m)
+{
+	return m->net;
+}
+
+extern int (*cesar_shim_proc_show)(struct seq_file *m, void *v);
+
+static inline struct proc_dir_entry *
+proc_create_net_single(const char *name, umode_t mode,
+		       struct proc_dir_entry *parent,
+		       int (*show)(struct seq_file *m, void *v), void *data)
+{
+	(void)name;
+	(void)mode;
+	(void)parent;
+	(void)data;
+	cesar_shim_proc_show = show;
+	return (struct proc_dir_entry *)&cesar_shim_proc_show;
+}
+
+static inline void remove_proc_entry(const char *name,
+				     struct proc_dir_entry *parent)
+{
+	(void)name;
+	(void)parent;
+	cesar_shim_proc_show = NULL;
+}
+
+/* debugfs: files are never created, the handles only need to be non-NULL */
+struct dentry;
+struct file_operations {
+	int	(*open)(void);
+};
+
+#define DEFINE_SHOW_ATTRIBUTE(name)					\
+	static const struct file_operations name##_fops = {		\
+		.open = (int (*)(void))name##_show,			\
+	}
+
+static inline struct dentry *debugfs_create_dir(const char *name,
+						struct dentry *parent)
+{
+	(void)name;
+	(void)parent;
+	return (struct dentry *)&debugfs_create_dir;
+}
+
+static inline struct dentry *
+debugfs_create_file(const char *name, umode_t mode, struct dentry *parent,
+		    void *data, const struct file_operations *fops)
+{
+	(void)name;
+	(void)mode;
+	(void)data;
+	(void)fops;
+	return parent;
+}
+
+static inline void debugfs_remove(struct dentry *dentry)
+{
+	(void)dentry;
+}
+
+/* relay: one channel whose records the harness appends to a file, see -B;
+ * it never fills, so subbuf_start() is never asked to drop.
+ */
+struct rchan_buf;
+struct rchan;
+
+struct rchan_callbacks {
+	int (*subbuf_start)(struct rchan_buf *buf, void *subbuf,
+			    void *prev_subbuf, size_t prev_padding);
+	struct dentry *(*create_buf_file)(const char *filename,
+					  struct dentry *parent, umode_t mode,
+					  struct rchan_buf *buf, int *is_global);
+	int (*remove_buf_file)(struct dentry *dentry);
+};
+
+static const struct file_operations relay_file_operations;
+
+extern FILE *cesar_shim_relay_out;
+
+static inline struct rchan *relay_open(const char *base_filename,
+				       struct dentry *parent,
+				       size_t subbuf_size, size_t n_subbufs,
+				       const struct rchan_callbacks *cb,
+				       void *private_data)
+{
+	(void)base_filename;
+	(void)parent;
+	(void)subbuf_size;
+	(void)n_subbufs;
+	(void)cb;
+	(void)private_data;
+	return cesar_shim_relay_out ? (struct rchan *)cesar_shim_relay_out : NULL;
+}
+
+static inline void relay_close(struct rchan *chan)
+{
+	(void)chan;
+	fflush(cesar_shim_relay_out);
+}
+
+static inline void relay_write(struct rchan *chan, const void *data,
+			       size_t length)
+{
+	(void)chan;
+	fwrite(data, length, 1, cesar_shim_relay_out);
+}
+
+static inline int relay_buf_full(struct rchan_buf *buf)
+{
+	(void)buf;
+	return 0;
+}
+
+/* Sockets */
+enum sk_pacing {
+	SK_PACING_NONE		= 0,
+	SK_PACING_NEEDED	= 1,
+	SK_PACING_FQ		= 2,
+};
+
+struct sock {
+	u16			sk_family;
+	__be32			sk_daddr;
+	unsigned long		sk_pacing_rate;
+	unsigned long		sk_max_pacing_rate;
+	unsigned int		sk_gso_max_size;
+	u32			sk_pacing_status;
+	u8			sk_pacing_shift;
+	atomic64_t		sk_cookie;
+};
+
+struct inet_sock {
+	struct sock		sk;
+	__be16			inet_sport;
+	__be16			inet_dport;
+};
+
+#define ICSK_CA_PRIV_SIZE	104
+
+struct inet_connection_sock {
+	struct inet_sock	icsk_inet;
+	const struct tcp_congestion_ops *icsk_ca_ops;
+	u8			icsk_ca_state;
+	u64			icsk_ca_priv[ICSK_CA_PRIV_SIZE / sizeof(u64)];
+};
+
+struct tcp_sock {
+	struct inet_connection_sock inet_conn;
+	u16	advmss;
+	u32	mss_cache;
+	u32	snd_cwnd;
+	u32	snd_cwnd_clamp;
+	u32	snd_ssthresh;
+	u32	prior_cwnd;
+	u32	packets_out;
+	u32	sacked_out;
+	u32	lost_out;
+	u32	retrans_out;
+	u32	delivered;
+	u32	delivered_ce;
+	u32	lost;
+	u32	app_limited;
+	u64	tcp_mstamp;
+	u64	tcp_clock_cache;
+	u64	tcp_wstamp_ns;
+	u64	bytes_acked;
+};
+
+static inline struct net *sock_net(const struct sock *sk)
+{
+	(void)sk;
+	return &init_net;
+}
+
+static inline struct inet_sock *inet_sk(const struct sock *sk)
+{
+	return (struct inet_sock *)sk;
+}
+
+static inline struct inet_connection_sock *inet_csk(const struct sock *sk)
+{
+	return (struct inet_connection_sock *)sk;
+}
+
+static inline void *inet_csk_ca(const struct sock *sk)
+{
+	return (void *)inet_csk(sk)->icsk_ca_priv;
+}
+
+static inline struct tcp_sock *tcp_sk(const struct sock *sk)
+{
+	return (struct tcp_sock *)sk;
+}
+
+/* TCP */
+#define TCP_INIT_CWND		10
+#define TCP_INFINITE_SSTHRESH	0x7fffffff
+#define MAX_TCP_HEADER		320
+#define GSO_MAX_SIZE		65536
+#define TCP_CONG_NON_RESTRICTED	0x1
+#define TCP_CONG_NEEDS_ECN	0x2
+
+enum tcp_ca_state {
+	TCP_CA_Open = 0,
+	TCP_CA_Disorder = 1,
+	TCP_CA_CWR = 2,
+	TCP_CA_Recovery = 3,
+	TCP_CA_Loss = 4
+};
+
+enum tcp_ca_event {
+	CA_EVENT_TX_START,
+	CA_EVENT_CWND_RESTART,
+	CA_EVENT_COMPLETE_CWR,
+	CA_EVENT_LOSS,
+	CA_EVENT_ECN_NO_CE,
+	CA_EVENT_ECN_IS_CE,
+};
+
+static inline unsigned int tcp_left_out(const struct tcp_sock *tp)
+{
+	return tp->sacked_out + tp->lost_out;
+}
+
+static inline unsigned int tcp_packets_in_flight(const struct tcp_sock *tp)
+{
+	return tp->packets_out - tcp_left_out(tp) + tp->retrans_out;
+}
+
+static inline bool before(u32 seq1, u32 seq2)
+{
+	return (s32)(seq1 - seq2) < 0;
+}
+#define after(seq2, seq1)	before(seq1, seq2)
+
+struct ack_sample {
+	u32 pkts_acked;
+	s32 rtt_us;
+	u32 in_flight;
+};
+
+struct rate_sample {
+	u64  prior_mstamp;
+	u32  prior_delivered;
+	u32  prior_delivered_ce;
+	s32  delivered;
+	s32  delivered_ce;
+	long interval_us;
+	u32 snd_interval_us;
+	u32 rcv_interval_us;
+	long rtt_us;
+	int  losses;
+	u32  acked_sacked;
+	u32  prior_in_flight;
+	bool is_app_limited;
+	bool is_retrans;
+	bool is_ack_delayed;
+};
+
+/* inet_diag */
+#define INET_DIAG_VEGASINFO	3
+#define INET_DIAG_BBRINFO	16
+
+union tcp_cc_info {
+	__u32	raw[5];		/* tcpvegas_info, tcp_dctcp_info, tcp_bbr_info */
+};
+
+#define TCP_CA_NAME_MAX	16
+
+struct tcp_congestion_ops {
+	u32 (*ssthresh)(struct sock *sk);
+	void (*cong_avoid)(struct sock *sk, u32 ack, u32 acked);
+	void (*set_state)(struct sock *sk, u8 new_state);
+	void (*cwnd_event)(struct sock *sk, enum tcp_ca_event ev);
+	void (*in_ack_event)(struct sock *sk, u32 flags);
+	void (*pkts_acked)(struct sock *sk, const struct ack_sample *sample);
+	u32 (*min_tso_segs)(struct sock *sk);
+	void (*cong_control)(struct sock *sk, u32 ack, int flag,
+			     const struct rate_sample *rs);
+	u32 (*undo_cwnd)(struct sock *sk);
+	u32 (*sndbuf_expand)(struct sock *sk);
+	size_t (*get_info)(struct sock *sk, u32 ext, int *attr,
+			   union tcp_cc_info *info);
+	char name[TCP_CA_NAME_MAX];
+	struct module *owner;
+	void (*init)(struct sock *sk);
+	void (*release)(struct sock *sk);
+	u32 flags;
+};
+
+static inline int tcp_register_congestion_control(struct tcp_congestion_ops *ca)
+{
+	(void)ca;
+	return 0;
+}
+
+static inline void tcp_unregister_congestion_control(struct tcp_congestion_ops *ca)
+{
+	(void)ca;
+}
+
+#endif /* _CESAR_SHIM_H */
@@ -0,0 +1,2 @@
+/* replay stub, see cesar_shim.h */
+#include "cesar_shim.h"
@@ -0,0 +1,17 @@
+/* replay stub, see cesar_shim.h: every tracepoint compiles to a no-op. */
+#ifndef _CESAR_SHIM_TRACEPOINT_H
+#define _CESAR_SHIM_TRACEPOINT_H
+
+#include "cesar_shim.h"
+
+#define TP_PROTO(args...)	args
+#define TP_ARGS(args...)	args
+#define TRACE_DEFINE_ENUM(a)
+
+#define DECLARE_EVENT_CLASS(name, proto, args, tstruct, assign, print)
+#define DEFINE_EVENT(template, name, proto, args)			\
+	static inline void trace_##name(proto) {}
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print)		\
+	static inline void trace_##name(proto) {}
+
+#endif
@@ -0,0 +1 @@
+/* replay stub, see linux/tracepoint.h */
@@ -5,6 +5,19 @@
 #include <linux/inet.h>
 #include <linux/random.h>
 #include <linux/win_minmax.h>
+#include <linux/sysctl.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/hashtable.h>
+#include <linux/relay.h>
+#include <linux/debugfs.h>
+#include <linux/version.h>
+#include <net/ipv6.h>
+#include <net/net_namespace.h>
+#include <net/netns/generic.h>
+
+#include "tcp_cesar_info.h"
 
 
 #define BW_SCALE 24
@@ -18,71 +31,231 @@
 
 #define LINE_MARGIN 500
 
+/* Histogram bins are PATTERN_BIN_MIN_US << pattern_bin_shift wide, picked
+ * per profile: 125-250 us resolves NR slots, 1-2 ms reaches past 20 ms
+ * for LTE-M. LINE_MARGIN is the default; su being a u16 caps the range.
+ */
+#define PATTERN_BIN_MIN_US 125
+#define PATTERN_BIN_SHIFT_MAX 4
+
 #define INITIAL_SU 5000
 
 #define MAX_PATTERN_COUNT 40
 
+/* rtt_pattern bins are 4-bit counters packed into u32 words so the whole
+ * histogram lives in struct cesar. A bin that would overflow halves every
+ * bin and bumps pattern_shift, so bin << pattern_shift approximates the
+ * raw count. Each decision ages the histogram by half instead of clearing
+ * it, so the SU estimate keeps following the link.
+ */
+#define PATTERN_BIN_BITS 4
+#define PATTERN_BIN_MAX ((1U << PATTERN_BIN_BITS) - 1)
+#define PATTERN_BINS_PER_WORD (32 / PATTERN_BIN_BITS)
+#define PATTERN_WORDS DIV_ROUND_UP(MAX_PATTERN_COUNT, PATTERN_BINS_PER_WORD)
+#define PATTERN_HALVE_MASK 0x77777777U
+#define PATTERN_SHIFT_MAX 7
+
 #define MAX_SORTING 3
 
 #define INTERVAL_MIN 30000
 #define INTERVAL_MIN_INDEX INTERVAL_MIN/500
 
-#define PATTERN_DECISON_PERIOD 250
-
-static int cesar_mode_outside __read_mostly = 0;
-static int cesar_scheduling_unit __read_mostly = 0;
-static int cesar_alpha __read_mostly = 2;
-static int cesar_beta __read_mostly = 5;
-static int cesar_gamma __read_mostly = 8;
-
-
-module_param(cesar_mode_outside, int, 0644);
-MODULE_PARM_DESC(cesar_mode_outside, "mode");
-module_param(cesar_scheduling_unit, int, 0644);
-MODULE_PARM_DESC(cesar_scheduling_unit, "scheduling_unit");
-module_param(cesar_alpha, int, 0644);
-MODULE_PARM_DESC(cesar_alpha, "alpha");
-module_param(cesar_beta, int, 0644);
-MODULE_PARM_DESC(cesar_beta, "beta");
-module_param(cesar_gamma, int, 0644);
-MODULE_PARM_DESC(cesar_gamma, "alpha");
-
-enum cesar_mode {
-	CESAR_STARTUP,	
-	CESAR_DRAIN,	
-	CESAR_STEADY,
-    CESAR_BBR,
+#define PATTERN_DECISION_PERIOD 64	/* samples between SU decisions */
+#define PATTERN_MIN_BIN 5		/* shorter gaps are ACKs within one SU */
+#define PATTERN_MIN_BIN_FINE 4		/* the same for bins under LINE_MARGIN */
+#define PATTERN_PEAK_SPREAD 4		/* bins on either side of a peak it owns */
+#define PATTERN_PEAK_MIN 8		/* scaled count needed to lock on an SU */
+
+/* su_confidence: share of the histogram that is periodic in su, in 1/16 */
+#define SU_CONF_SCALE 4
+#define SU_CONF_MAX ((1U << SU_CONF_SCALE) - 1)
+#define SU_CONF_ENTER 6			/* to lock on an SU */
+#define SU_CONF_EXIT 3			/* to give it up and fall back to BBR */
+#define SU_CONF_SMOOTH 4		/* weight 1/4 for each new score */
+
+#define SU_BURST_DIV 4			/* su_pacing sends an SU's budget in su / 4 */
+
+/* Per-class tuning. Each parameter is an array with one entry per profile.
+ * The module registers one congestion control per profile, "cesar" for
+ * profile 0 and "cesar1" to "cesar7" for the others, so a socket picks its
+ * profile with setsockopt(TCP_CONGESTION) or bpf_setsockopt(). Only the
+ * index is kept in struct cesar, which has no room for copies of the
+ * values: flows read their profile's values live, and a sysfs or sysctl
+ * write reaches running flows on their next ACK. pattern_bin_us is the
+ * exception, taken once at init. Writing a single value to the sysfs file
+ * only sets profile 0.
+ */
+#define CESAR_NR_PROFILES 8
+
+struct cesar_params {
+	int	scheduling_unit[CESAR_NR_PROFILES];
+	int	alpha[CESAR_NR_PROFILES];
+	int	beta[CESAR_NR_PROFILES];
+	int	gamma[CESAR_NR_PROFILES];
+	int	pattern_bin_us[CESAR_NR_PROFILES];
+	int	su_pacing[CESAR_NR_PROFILES];
+	int	share[CESAR_NR_PROFILES];
+};
+
+/* The initial netns uses these, shared with the module parameters. */
+static struct cesar_params cesar_init_params __read_mostly = {
+	.scheduling_unit	= { [0 ... CESAR_NR_PROFILES - 1] = 0 },
+	.alpha			= { [0 ... CESAR_NR_PROFILES - 1] = 2 },
+	.beta			= { [0 ... CESAR_NR_PROFILES - 1] = 5 },
+	.gamma			= { [0 ... CESAR_NR_PROFILES - 1] = 8 },
+	.pattern_bin_us		= { [0 ... CESAR_NR_PROFILES - 1] = LINE_MARGIN },
+	.su_pacing		= { [0 ... CESAR_NR_PROFILES - 1] = 0 },
+	.share			= { [0 ... CESAR_NR_PROFILES - 1] = 0 },
+};
+
+
+module_param_array_named(cesar_scheduling_unit, cesar_init_params.scheduling_unit, int, NULL, 0644);
+MODULE_PARM_DESC(cesar_scheduling_unit, "scheduling_unit per profile, 0 detects it");
+module_param_array_named(cesar_alpha, cesar_init_params.alpha, int, NULL, 0644);
+MODULE_PARM_DESC(cesar_alpha, "alpha per profile");
+module_param_array_named(cesar_beta, cesar_init_params.beta, int, NULL, 0644);
+MODULE_PARM_DESC(cesar_beta, "beta per profile");
+module_param_array_named(cesar_gamma, cesar_init_params.gamma, int, NULL, 0644);
+MODULE_PARM_DESC(cesar_gamma, "gamma per profile");
+module_param_array_named(cesar_pattern_bin_us, cesar_init_params.pattern_bin_us, int, NULL, 0644);
+MODULE_PARM_DESC(cesar_pattern_bin_us, "SU histogram bin width per profile, 125 us doubled up to 2000 us; new flows only");
+module_param_array_named(cesar_su_pacing, cesar_init_params.su_pacing, int, NULL, 0644);
+MODULE_PARM_DESC(cesar_su_pacing, "send each SU's budget as one burst aligned to the SU grid, per profile (0/1)");
+module_param_array_named(cesar_share, cesar_init_params.share, int, NULL, 0644);
+MODULE_PARM_DESC(cesar_share, "share su, min_rtt and bandwidth between flows to one destination, per profile (0/1)");
+
+/* ECN capability is negotiated through tcp_congestion_ops.flags, which
+ * every flow on the module shares, so this one is fixed at load time.
+ */
+static bool cesar_ecn __read_mostly;
+module_param(cesar_ecn, bool, 0444);
+MODULE_PARM_DESC(cesar_ecn, "negotiate ECN and cut cwnd_est on CE marks, DCTCP style (load time)");
+
+/* Event counters for /proc/net/tcp_cesar_stat, per netns and per CPU so
+ * the hot path never shares a cache line; they are summed on read. Only
+ * events that change a flow's state are counted, never plain ACKs.
+ */
+enum cesar_stat {
+	CESAR_STAT_FLOWS,		/* cesar_init() */
+	CESAR_STAT_SU_DECISIONS,	/* cesar_pattern_decision() verdicts */
+	CESAR_STAT_SU_LOCKS,		/* ... that took BBR back to STEADY */
+	CESAR_STAT_SU_SWITCHES,		/* ... that moved a locked su */
+	CESAR_STAT_SU_FALLBACKS,	/* ... that gave STEADY up for BBR */
+	CESAR_STAT_STARTUP_EXIT_BW,	/* bw stopped growing */
+	CESAR_STAT_STARTUP_EXIT_RTT,	/* cesar_check_rtt_inflation() */
+	CESAR_STAT_STARTUP_EXIT_LOSS,
+	CESAR_STAT_DRAIN_TIMEOUTS,	/* cesar_drain_max_rounds ran out */
+	CESAR_STAT_RTO_RESEEDS,
+	CESAR_STAT_ECN_CUTS,
+	CESAR_STAT_DST_SEEDS,		/* flows started from a shared entry */
+	CESAR_STAT_MAX
+};
+
+#define CESAR_NR_MODES (CESAR_BBR + 1)
+/* su at each decision in STEADY, LINE_MARGIN wide; the last takes the rest */
+#define CESAR_SU_HIST_BUCKETS (MAX_PATTERN_COUNT + 1)
+
+struct cesar_stats {
+	u64	events[CESAR_STAT_MAX];
+	u64	mode_change[CESAR_NR_MODES][CESAR_NR_MODES];	/* [from][to] */
+	u64	released[CESAR_NR_MODES];	/* flows that ended in a mode */
+	u64	su_hist[CESAR_SU_HIST_BUCKETS];
+};
+
+#ifndef CESAR_BPF
+#define CESAR_DST_HASH_BITS 8
+#define CESAR_DST_MAX 4096		/* entries per netns */
+#define CESAR_DST_TTL (10 * HZ)		/* an idle entry is trusted this long */
+
+/* What flows to one destination learnt about its bearer, see
+ * cesar_dst_get(). Published without a lock, so a reader may see fields
+ * from two updates; each is a plausible value on its own.
+ */
+struct cesar_dst {
+	struct hlist_node	node;
+	struct rcu_head		rcu;
+	u64			prefix;		/* IPv4 address or IPv6 /64 */
+	u16			family;
+	u16			su;
+	u32			min_rtt_us;
+	u32			bw;		/* the whole bearer's, as max_bw */
+	unsigned long		stamp;		/* jiffies of the last update */
+	atomic_t		flows;		/* flows holding it */
+};
+
+/* Every other netns gets its own copy, taken from the initial netns when
+ * it is created and tuned through net.ipv4.tcp_cesar_* from then on.
+ */
+struct cesar_net {
+	struct cesar_params	*params;
+	struct cesar_params	own_params;
+	struct ctl_table_header	*sysctl_hdr;
+	struct cesar_stats __percpu *stats;
+	DECLARE_HASHTABLE(dst_hash, CESAR_DST_HASH_BITS);
+	spinlock_t		dst_lock;	/* adds and removes in dst_hash */
+	unsigned int		dst_count;
 };
 
+static unsigned int cesar_net_id __read_mostly;
+
+/* Per-ACK sample capture for offline model fitting, see cesar_capture().
+ * cesar_capture_kb sizes a per-CPU relay buffer under debugfs tcp_cesar/
+ * at load time, none by default; flows whose local or remote port is
+ * cesar_capture_port (-1 for every flow) or whose socket cookie is
+ * cesar_capture_cookie then write into it. tools/cesar_capture drains it.
+ */
+static unsigned int cesar_capture_kb __read_mostly;
+module_param(cesar_capture_kb, uint, 0444);
+MODULE_PARM_DESC(cesar_capture_kb, "per-CPU sample capture buffer in KiB, 0 for none (load time)");
+static int cesar_capture_port __read_mostly;
+module_param(cesar_capture_port, int, 0644);
+MODULE_PARM_DESC(cesar_capture_port, "capture flows with this local or remote port, -1 for all, 0 for none");
+static unsigned long long cesar_capture_cookie __read_mostly;
+module_param(cesar_capture_cookie, ullong, 0644);
+MODULE_PARM_DESC(cesar_capture_cookie, "capture the flow with this socket cookie, 0 for none");
+
+#define CESAR_CAPTURE_SUBBUF	(64 << 10)
+
+static struct dentry *cesar_capture_dir;
+static struct rchan *cesar_capture_chan;
+/* samples dropped because a CPU's buffer was full, in tcp_cesar/lost */
+static DEFINE_PER_CPU(u64, cesar_capture_lost);
+#endif
+
 struct cesar {
 	u32	min_rtt_us;	        
-	// u32	min_rtt_stamp;	        
+	u32	min_rtt_stamp;		/* jiffies, see cesar_update_min_rtt() */
 
 	struct minmax bw;
 
-	u16	rtt_cnt;	    
+	u16 su;
+	u16 clock_pass;		/* stays below su, see cesar_scheduling_unit_adjust() */
 	u32     next_rtt_delivered; 
 	u32     mode:3,		    
 		prev_ca_state:3,    
 		packet_conservation:1, 
 		restore_cwnd:1,	     
 		round_start:1,	     
-		tso_segs_goal:7,     
-		pattern_count:16;
+		probe_rtt:1,		/* refreshing min_rtt_us */
+		probe_rtt_round_done:1,
+		pattern_bin_shift:3,	/* see cesar_pattern_bin_us() */
+		dst_shared:1,		/* holds a cesar_dst, see cesar_dst_get() */
+		idle_restart:1,		/* sending again after an app-limited idle */
+		rtt_cnt:16;
 	
-	u32	pacing_gain:16,	
+	u32	pacing_gain:10,	
 		full_bw_reached:1,  
 		full_bw_cnt:2,	
-		cycle_idx:3,	
-		su_found:1, 
+		pattern_shift:3,
 		gathering_current_scheduling_unit:1,
-		pattern_decision_count:8;
+		pattern_count:7,	/* up to PATTERN_DECISION_PERIOD */
+		profile:3,		/* index into the per-profile params */
+		su_confidence:4,	/* SU_CONF_*, see cesar_su_confidence() */
+		rto_pending:1;		/* in Loss, not undone yet, see cesar_set_state() */
 
 	u32 cwnd_est; 
 
-	u16 su;
-
-	u8 *rtt_pattern; 
+	u32 rtt_pattern[PATTERN_WORDS];
 
 	u32 previous_rtt; 
 
@@ -90,28 +263,84 @@ struct cesar {
 
 	u32	ewma_bw;
 
-	u32 clock_pass;
+	u16 scheduling_unit_delivered;
 
-	u32 scheduling_unit_delivered;
+	u16 previous_ack;
 
-	u32 scheduling_unit_interval_us;
+	/* STARTUP has no SU accounting yet, so its round RTTs share the space */
+	union {
+		struct {
+			u32 scheduling_unit_interval_us;
 
-	u32 previous_clock_diff;
+			u32 previous_clock_diff;
+		};
+		struct {
+			u32 round_min_rtt_us;	/* see cesar_check_rtt_inflation() */
 
-	u32 previous_ack;
+			u32 last_round_min_rtt_us;
+		};
+	};
 
 	u32 previous_previous_rtt;
 
 	u32 previous_bw;
 };
 
+#define CREATE_TRACE_POINTS
+#include "tcp_cesar_trace.h"
+
+static u8 cesar_profile(const struct sock *sk)
+{
+	const struct cesar *cesar = inet_csk_ca(sk);
+
+	return cesar->profile;
+}
+
+/* This flow's value of a parameter, from its netns and profile */
+#define cesar_param(sk, name) \
+	READ_ONCE(cesar_params(sk)->name[cesar_profile(sk)])
+
+#ifdef CESAR_BPF
+/* bpf/tcp_cesar.bpf.c has no netns hooks or per-CPU allocator: every flow
+ * uses cesar_init_params as the loader set them, and nothing is counted.
+ */
+static const struct cesar_params *cesar_params(const struct sock *sk)
+{
+	return &cesar_init_params;
+}
+
+#define cesar_stat_inc(sk, field) do { } while (0)
+#else
+static const struct cesar_params *cesar_params(const struct sock *sk)
+{
+	const struct cesar_net *cn = net_generic(sock_net(sk), cesar_net_id);
+
+	return cn->params;
+}
+
+static struct cesar_stats __percpu *cesar_stats(const struct sock *sk)
+{
+	const struct cesar_net *cn = net_generic(sock_net(sk), cesar_net_id);
+
+	return cn->stats;
+}
+
+#define cesar_stat_inc(sk, field) this_cpu_inc(cesar_stats(sk)->field)
+#endif
+
 // testing
 #define BASELINE 200
 #define TMP 0
 
 static const int cesar_bw_rtts = 30;
 
-static const u32 cesar_min_rtt_win_sec = 30;
+/* min_rtt_us older than this is refreshed through a probe_rtt phase */
+static const u32 cesar_min_rtt_win_sec = 10;
+
+/* probe_rtt caps cwnd at this fraction of the target instead of BBR's
+ * 4 packets, so a refresh costs at most half a BDP for about two rounds.
+ */
+static const int cesar_probe_rtt_cwnd_gain = CESAR_UNIT / 2;
 
 static const int cesar_min_tso_rate = 1200000;
 
@@ -132,6 +361,16 @@ static const u32 cesar_full_bw_thresh = CESAR_UNIT * 6 / 5;
 
 static const u32 cesar_full_bw_cnt = 3;
 
+/* DRAIN gives up on reaching one BDP after this many rounds */
+static const u32 cesar_drain_max_rounds = 2;
+
+/* HyStart++ (RFC 9406) bounds on the RTT growth that ends STARTUP */
+static const u32 cesar_rtt_inflation_min_us = 4000;
+static const u32 cesar_rtt_inflation_max_us = 16000;
+
+/* cwnd_est is scaled by this on entering fast recovery, like CUBIC's beta */
+static const u32 cesar_loss_beta = CESAR_UNIT * 7 / 10;
+
 static bool cesar_full_bw_reached(const struct sock *sk)
 {
 	const struct cesar *cesar = inet_csk_ca(sk);
@@ -146,21 +385,43 @@ static u32 cesar_max_bw(const struct sock *sk)
 	return minmax_get(&cesar->bw);
 }
 
+/* max_bw * min_rtt in packets, the inflight DRAIN brings STARTUP down to */
+static u32 cesar_bdp(const struct sock *sk)
+{
+	const struct cesar *cesar = inet_csk_ca(sk);
+	u64 bdp = (u64)cesar_max_bw(sk) * cesar->min_rtt_us;
 
-static u32 cesar_ewma_bw_alpha(const struct sock *sk, const struct rate_sample *rs)
+	return max_t(u64, (bdp + BW_UNIT - 1) >> BW_SCALE, cesar_cwnd_min_target);
+}
+
+static void cesar_set_mode(struct sock *sk, u8 mode)
 {
 	struct cesar *cesar = inet_csk_ca(sk);
-	struct tcp_sock *tp = tcp_sk(sk);
 
-	if( !(rs->interval_us > 0) ||  (cesar->su == 0)){
-		return cesar->ewma_bw * cesar_alpha;
+	if (cesar->mode != mode) {
+		trace_cesar_mode_change(sk, cesar->mode, mode);
+		cesar_stat_inc(sk, mode_change[cesar->mode][mode]);
+	}
+	if (cesar->mode == CESAR_STARTUP && mode != CESAR_STARTUP) {
+		cesar->scheduling_unit_interval_us = 0;
+		cesar->previous_clock_diff = 0;
 	}
+	cesar->mode = mode;
+}
 
-	if(cesar->mode != CESAR_STEADY){
+
+/* The rate to pace at: max_bw until STEADY, ewma_bw * alpha in it. An
+ * ACK without a rate sample must not switch a STARTUP or BBR flow over to
+ * ewma_bw, which is 0 or stale there.
+ */
+static u32 cesar_ewma_bw_alpha(const struct sock *sk, const struct rate_sample *rs)
+{
+	const struct cesar *cesar = inet_csk_ca(sk);
+
+	if (cesar->mode != CESAR_STEADY)
 		return cesar_max_bw(sk);
-	}
 
-	return cesar->ewma_bw * cesar_alpha;
+	return min_t(u64, (u64)cesar->ewma_bw * cesar_param(sk, alpha), U32_MAX);
 }
 
 
@@ -173,11 +434,8 @@ static u64 cesar_rate_bytes_per_sec(struct sock *sk, u64 rate, int gain)
 	return rate >> BW_SCALE;
 }
 
-static u32 cesar_bw_to_pacing_rate(struct sock *sk, u32 bw, int gain,const struct rate_sample *rs)
+static u64 cesar_bw_to_pacing_rate(struct sock *sk, u32 bw, int gain,const struct rate_sample *rs)
 {
-	struct cesar *cesar = inet_csk_ca(sk);
-	struct tcp_sock *tp = tcp_sk(sk);
-
 	u64 rate = 0;
 	if(cesar_full_bw_reached(sk)){
 		rate = bw;
@@ -197,17 +455,35 @@ static u32 cesar_bw_to_pacing_rate(struct sock *sk, u32 bw, int gain,const struc
 
 static void cesar_set_pacing_rate(struct sock *sk, u32 bw, int gain,const struct rate_sample *rs)
 {
-	struct tcp_sock *tp = tcp_sk(sk);
-	struct cesar *cesar = inet_csk_ca(sk);
-	u32 rate = cesar_bw_to_pacing_rate(sk, bw, gain,rs);
+	u64 rate = cesar_bw_to_pacing_rate(sk, bw, gain,rs);
 
 	sk->sk_pacing_rate = rate;
-	
+}
+
+/* Once the SU is known, one skb may carry up to what the cell grants the
+ * flow in an SU, ewma_bw * su: fewer, larger skbs through the qdisc and
+ * driver, and none so large that part of it waits out a further SU.
+ * Capped at what the device takes in one GSO skb, sk_gso_max_size, which
+ * may well be past 64 KB since 5.19; tcp_tso_autosize() then caps it
+ * at sk_gso_max_segs.
+ */
+static u32 cesar_su_tso_segs(struct sock *sk)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
+	u32 segs;
+
+	if (cesar->mode != CESAR_STEADY || !cesar->su)
+		return 0;
+
+	segs = min_t(u64, (u64)cesar->ewma_bw * cesar->su >> BW_SCALE, 0x7FU);
+	return min(segs, READ_ONCE(sk->sk_gso_max_size) / tcp_sk(sk)->mss_cache);
 }
 
 static u32 cesar_min_tso_segs(struct sock *sk)
 {
-	return sk->sk_pacing_rate < (cesar_min_tso_rate >> 3) ? 1 : 2;
+	u32 segs = sk->sk_pacing_rate < (cesar_min_tso_rate >> 3) ? 1 : 2;
+
+	return max(segs, cesar_su_tso_segs(sk));
 }
 
 static u32 cesar_tso_segs_goal(struct sock *sk)
@@ -251,6 +527,46 @@ static u32 cesar_target_cwnd(struct sock *sk, u32 bw, int gain, const struct rat
 	return cwnd;
 }
 
+/* Packet conservation for the first round of recovery, and the cwnd TCP
+ * saved in tp->prior_cwnd put back once recovery ends. Returns true when
+ * *new_cwnd must not grow any further on this ACK.
+ */
+static bool cesar_set_cwnd_to_recover_or_restore(struct sock *sk,
+	const struct rate_sample *rs, u32 acked, u32 *new_cwnd)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct cesar *cesar = inet_csk_ca(sk);
+	u8 prev_state = cesar->prev_ca_state, state = inet_csk(sk)->icsk_ca_state;
+	u32 cwnd = tp->snd_cwnd;
+
+	if (rs->losses > 0)
+		cwnd = max_t(s32, cwnd - rs->losses, 1);
+
+	if (state == TCP_CA_Recovery && prev_state != TCP_CA_Recovery) {
+		/* Starting 1st round of Recovery, so do packet conservation. */
+		cesar->packet_conservation = 1;
+		cesar->next_rtt_delivered = tp->delivered;  /* start round now */
+		cwnd = tcp_packets_in_flight(tp) + acked;
+	} else if (prev_state >= TCP_CA_Recovery && state < TCP_CA_Recovery) {
+		/* Exiting loss recovery; restore cwnd saved before recovery. */
+		cesar->restore_cwnd = 1;
+		cesar->packet_conservation = 0;
+	}
+	cesar->prev_ca_state = state;
+
+	if (cesar->restore_cwnd) {
+		cwnd = max(cwnd, tp->prior_cwnd);
+		cesar->restore_cwnd = 0;
+	}
+
+	if (cesar->packet_conservation) {
+		*new_cwnd = max(cwnd, tcp_packets_in_flight(tp) + acked);
+		return true;
+	}
+	*new_cwnd = cwnd;
+	return false;
+}
+
 static void cesar_set_cwnd(struct sock *sk, const struct rate_sample *rs,
 			 u32 acked, u32 bw, int gain)
 {
@@ -261,7 +577,8 @@ static void cesar_set_cwnd(struct sock *sk, const struct rate_sample *rs,
 	if (!acked)
 		return;
 
-	cwnd = tp->snd_cwnd;
+	if (cesar_set_cwnd_to_recover_or_restore(sk, rs, acked, &cwnd))
+		goto done;
 		
     target_cwnd = cesar_target_cwnd(sk, bw, gain,rs);
     if (cesar_full_bw_reached(sk)){
@@ -269,8 +586,11 @@ static void cesar_set_cwnd(struct sock *sk, const struct rate_sample *rs,
     } else if (cwnd < target_cwnd || tp->delivered < TCP_INIT_CWND){
         cwnd = cwnd + acked;
     }
+    if (cesar->probe_rtt)
+        cwnd = min(cwnd, (u32)(((u64)target_cwnd * cesar_probe_rtt_cwnd_gain) >> CESAR_SCALE));
     cwnd = max(cwnd, cesar_cwnd_min_target);
-	
+
+done:
 	tp->snd_cwnd = min(cwnd, tp->snd_cwnd_clamp);
 }
 
@@ -289,18 +609,27 @@ static void cesar_reset_steady_mode(struct sock *sk, const struct rate_sample *r
 	struct cesar *cesar = inet_csk_ca(sk);
 	struct tcp_sock *tp = tcp_sk(sk);
 
-	cesar->cwnd_est = tp->snd_cwnd;
+	cesar->cwnd_est = min(tp->snd_cwnd, cesar_bdp(sk));
 	cesar->cwnd_est *= tp->advmss;
-	cesar->mode = CESAR_STEADY;
+	cesar_set_mode(sk, CESAR_STEADY);
 	cesar->pacing_gain = CESAR_UNIT;
 	cesar->ewma_bw = cesar_max_bw(sk);
 }
 
-static void cesar_update_bw(struct sock *sk, const struct rate_sample *rs)
+/* Delivery rate of this ACK in BW_UNIT packets/us, 0 if there is none.
+ * Computed once per ACK and shared by the bw filter and the SU estimator.
+ */
+static u32 cesar_sample_bw(const struct rate_sample *rs)
+{
+	if (rs->delivered <= 0 || rs->interval_us <= 0)
+		return 0;
+	return div_u64((u64)rs->delivered * BW_UNIT, rs->interval_us);
+}
+
+static void cesar_update_bw(struct sock *sk, const struct rate_sample *rs, u32 bw)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct cesar *cesar = inet_csk_ca(sk);
-	u64 bw;
 
 	cesar->round_start = 0;
 	if (rs->delivered <= 0 || rs->interval_us <= 0)
@@ -314,10 +643,15 @@ static void cesar_update_bw(struct sock *sk, const struct rate_sample *rs)
 		cesar->packet_conservation = 0;
 	}
 
-	bw = (u64)rs->delivered * BW_UNIT;
-	do_div(bw, rs->interval_us);
-
 	if(cesar->mode != CESAR_STEADY){
+		/* Once the SU is known, a sample shorter than one only saw the
+		 * burst the cell just released; spread it over the whole SU.
+		 */
+		if ((cesar_param(sk, scheduling_unit) ||
+		     cesar->su_confidence >= SU_CONF_ENTER) &&
+		    rs->interval_us < cesar->su)
+			bw = div_u64((u64)rs->delivered * BW_UNIT, cesar->su);
+
 		if (!rs->is_app_limited || bw >= cesar_max_bw(sk)) {
 			minmax_running_max(&cesar->bw, 10, cesar->rtt_cnt, bw);
 		}
@@ -343,317 +677,842 @@ static void cesar_check_full_bw_reached(struct sock *sk,
 	}
 	++cesar->full_bw_cnt;
 	cesar->full_bw_reached = cesar->full_bw_cnt >= cesar_full_bw_cnt;
+	if (cesar->full_bw_reached && cesar->mode == CESAR_STARTUP)
+		cesar_stat_inc(sk, events[CESAR_STAT_STARTUP_EXIT_BW]);
 }
 
 
+/* HyStart++ style exit: a deep cellular buffer hides the delivery rate
+ * plateau for seconds, but not the queue. Leave STARTUP once a round's
+ * min RTT sits above the last round's by an eighth of it, clamped to
+ * 4-16 ms. A min over the round keeps SU-sized RTT steps out of it.
+ */
+static void cesar_check_rtt_inflation(struct sock *sk, const struct rate_sample *rs)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
+	u32 thresh;
+
+	if (cesar->mode != CESAR_STARTUP || cesar_full_bw_reached(sk))
+		return;
+
+	if (cesar->round_start) {
+		if (cesar->round_min_rtt_us && cesar->last_round_min_rtt_us) {
+			thresh = clamp(cesar->last_round_min_rtt_us >> 3,
+				       cesar_rtt_inflation_min_us,
+				       cesar_rtt_inflation_max_us);
+			if (cesar->round_min_rtt_us >=
+			    cesar->last_round_min_rtt_us + thresh) {
+				cesar->full_bw_reached = 1;
+				cesar_stat_inc(sk, events[CESAR_STAT_STARTUP_EXIT_RTT]);
+				return;
+			}
+		}
+		cesar->last_round_min_rtt_us = cesar->round_min_rtt_us;
+		cesar->round_min_rtt_us = 0;
+	}
+
+	if (rs->rtt_us > 0 && (!cesar->round_min_rtt_us ||
+			       rs->rtt_us < cesar->round_min_rtt_us))
+		cesar->round_min_rtt_us = rs->rtt_us;
+}
+
+/* Pace at the drain gain until inflight is back down to one BDP, then
+ * start STEADY from there rather than from STARTUP's queue. If it is not
+ * there within cesar_drain_max_rounds the BDP estimate is stale, so stop
+ * starving the flow. full_bw_cnt is free to count them once full_bw_reached.
+ */
 static void cesar_check_drain(struct sock *sk, const struct rate_sample *rs)
 {
 	struct cesar *cesar = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
 
 	if (cesar->mode == CESAR_STARTUP && cesar_full_bw_reached(sk)) {
-		cesar->mode = CESAR_DRAIN;	/* drain queue we created */
+		cesar_set_mode(sk, CESAR_DRAIN);	/* drain queue we created */
 		cesar->pacing_gain = cesar_drain_gain;	/* pace slow to drain */
+		cesar->full_bw_cnt = 0;
+	} else if (cesar->mode == CESAR_DRAIN && cesar->round_start) {
+		cesar->full_bw_cnt++;
+	}
+	if (cesar->mode != CESAR_DRAIN)
+		return;
+	if (tcp_packets_in_flight(tp) <= cesar_bdp(sk)) {
+		cesar_reset_steady_mode(sk,rs);
+	} else if (cesar->full_bw_cnt >= cesar_drain_max_rounds) {
+		cesar_stat_inc(sk, events[CESAR_STAT_DRAIN_TIMEOUTS]);
 		cesar_reset_steady_mode(sk,rs);
 	}
 }
 
+/* Windowed min filter: a min_rtt_us older than cesar_min_rtt_win_sec is
+ * refreshed, e.g. after a handover to a cell with a longer base RTT. Once
+ * the flow is past STARTUP this goes through a probe_rtt phase of two
+ * rounds. The first caps cwnd on the old min_rtt_us to drain our own
+ * queue; taking the expiry sample right away would size that cap on the
+ * queue it is meant to drain. The second round then starts the window
+ * afresh from what it samples.
+ */
 static void cesar_update_min_rtt(struct sock *sk, const struct rate_sample *rs)
 {
-	struct tcp_sock *tp = tcp_sk(sk);
 	struct cesar *cesar = inet_csk_ca(sk);
 	bool filter_expired;
 
-	// filter_expired = after(tcp_jiffies32,
-	// 		       cesar->min_rtt_stamp + cesar_min_rtt_win_sec * HZ);
-	
+	filter_expired = after(tcp_jiffies32,
+			       cesar->min_rtt_stamp + cesar_min_rtt_win_sec * HZ);
+
+	if (filter_expired && !cesar->probe_rtt && cesar_full_bw_reached(sk)) {
+		cesar->probe_rtt = 1;
+		cesar->probe_rtt_round_done = 0;
+		trace_cesar_probe_rtt(sk, true);
+	} else if (cesar->probe_rtt && cesar->round_start) {
+		if (cesar->probe_rtt_round_done) {
+			cesar->probe_rtt = 0;
+			cesar->min_rtt_stamp = tcp_jiffies32;
+			trace_cesar_probe_rtt(sk, false);
+		} else {
+			cesar->probe_rtt_round_done = 1;
+			if (rs->rtt_us > 0) {
+				cesar->min_rtt_us = rs->rtt_us;
+				cesar->min_rtt_stamp = tcp_jiffies32;
+			}
+		}
+	}
+
 	if (rs->rtt_us > 0 &&
-		((rs->rtt_us <= cesar->min_rtt_us))) {
+	    (rs->rtt_us <= cesar->min_rtt_us ||
+	     (filter_expired && !cesar->probe_rtt))) {
 		cesar->min_rtt_us = rs->rtt_us;
-		// cesar->min_rtt_stamp = tcp_jiffies32;
+		cesar->min_rtt_stamp = tcp_jiffies32;
 	}
+}
+
+/* struct_ops programs may only reach icsk_ca_priv at constant offsets, so
+ * the BPF build visits every word of rtt_pattern instead of indexing it.
+ */
+static u32 cesar_pattern_word(const struct cesar *cesar, u8 w)
+{
+#ifdef CESAR_BPF
+	u32 word = 0;
+	u8 i;
 
+#pragma unroll
+	for (i = 0; i < PATTERN_WORDS; i++)
+		if (i == w)
+			word = READ_ONCE(cesar->rtt_pattern[i]);
+	return word;
+#else
+	return cesar->rtt_pattern[w];
+#endif
 }
 
-void cesar_rtt_pattern_reset(struct sock *sk)
+static void cesar_pattern_word_set(struct cesar *cesar, u8 w, u32 word)
 {
-	struct cesar *cesar = inet_csk_ca(sk);
+#ifdef CESAR_BPF
 	u8 i;
-	for(i = 0 ; i < MAX_PATTERN_COUNT ; i++){
-		cesar->rtt_pattern[i] = 0;
+
+#pragma unroll
+	for (i = 0; i < PATTERN_WORDS; i++)
+		if (i == w)
+			WRITE_ONCE(cesar->rtt_pattern[i], word);
+#else
+	cesar->rtt_pattern[w] = word;
+#endif
+}
+
+static u32 cesar_pattern_get(const struct cesar *cesar, u8 idx)
+{
+	u32 word = cesar_pattern_word(cesar, idx / PATTERN_BINS_PER_WORD);
+
+	return (word >> ((idx % PATTERN_BINS_PER_WORD) * PATTERN_BIN_BITS)) & PATTERN_BIN_MAX;
+}
+
+static void cesar_pattern_set(struct cesar *cesar, u8 idx, u32 val)
+{
+	u8 w = idx / PATTERN_BINS_PER_WORD;
+	u32 word = cesar_pattern_word(cesar, w);
+	u32 shift = (idx % PATTERN_BINS_PER_WORD) * PATTERN_BIN_BITS;
+
+	word = (word & ~(PATTERN_BIN_MAX << shift)) | ((val & PATTERN_BIN_MAX) << shift);
+	cesar_pattern_word_set(cesar, w, word);
+}
+
+/* Halves every raw bin */
+static void cesar_pattern_halve(struct cesar *cesar)
+{
+	u8 i;
+
+	for (i = 0; i < PATTERN_WORDS; i++)
+		cesar_pattern_word_set(cesar, i,
+				       (cesar_pattern_word(cesar, i) >> 1) & PATTERN_HALVE_MASK);
+}
+
+/* Scaled count of a bin, comparable across halvings. */
+static u32 cesar_pattern_value(const struct cesar *cesar, u8 idx)
+{
+	return cesar_pattern_get(cesar, idx) << cesar->pattern_shift;
+}
+
+static void cesar_pattern_inc(struct cesar *cesar, u8 idx)
+{
+	u32 val = cesar_pattern_get(cesar, idx);
+
+	if (val == PATTERN_BIN_MAX) {
+		if (cesar->pattern_shift == PATTERN_SHIFT_MAX)
+			return;
+		cesar_pattern_halve(cesar);
+		cesar->pattern_shift++;
+		val = cesar_pattern_get(cesar, idx);
 	}
-	cesar->pattern_count = 0;
+	cesar_pattern_set(cesar, idx, val + 1);
 }
 
-void cesar_pattern_decision(struct sock *sk, const struct rate_sample *rs, u32 clock_diff)
+static u32 cesar_pattern_bin_us(const struct cesar *cesar)
+{
+	return PATTERN_BIN_MIN_US << cesar->pattern_bin_shift;
+}
+
+static u8 cesar_pattern_min_bin(const struct cesar *cesar)
+{
+	return cesar_pattern_bin_us(cesar) < LINE_MARGIN ?
+	       PATTERN_MIN_BIN_FINE : PATTERN_MIN_BIN;
+}
+
+/* One past the last bin whose SU still fits in cesar->su */
+static u8 cesar_pattern_max_bin(const struct cesar *cesar)
+{
+	return min_t(u32, MAX_PATTERN_COUNT, U16_MAX / cesar_pattern_bin_us(cesar) + 1);
+}
+
+/* Largest layout no wider than bin_us, taken once per flow since a new
+ * width would misread the bins already filled.
+ */
+static u8 cesar_pattern_bin_shift(int bin_us)
+{
+	u8 shift = 0;
+
+	while (shift < PATTERN_BIN_SHIFT_MAX &&
+	       (PATTERN_BIN_MIN_US << (shift + 1)) <= bin_us)
+		shift++;
+	return shift;
+}
+
+static void cesar_rtt_pattern_reset(struct sock *sk)
 {
 	struct cesar *cesar = inet_csk_ca(sk);
-	struct tcp_sock *tp = tcp_sk(sk);
-	
-	if(cesar->pattern_count < PATTERN_DECISON_PERIOD){
+
+	memset(cesar->rtt_pattern, 0, sizeof(cesar->rtt_pattern));
+	cesar->pattern_shift = 0;
+	cesar->pattern_count = 0;
+	cesar->su_confidence = 0;
+}
+
+/* Halve every scaled count; dropping pattern_shift first keeps the raw
+ * bins' precision.
+ */
+static void cesar_pattern_decay(struct cesar *cesar)
+{
+	if (cesar->pattern_shift) {
+		cesar->pattern_shift--;
 		return;
 	}
+	cesar_pattern_halve(cesar);
+}
 
-	u8 large_pattern_index[MAX_SORTING];
-	u8 large_pattern_value[MAX_SORTING];
+/* The MAX_SORTING largest peaks in one pass, largest first, without
+ * touching the histogram. A bin within PATTERN_PEAK_SPREAD of a peak
+ * already kept, with no empty bin between them, belongs to it and replaces
+ * it if at least as large: ACKs of an SU tend to arrive a little early, so
+ * gaps straddle two bins and the upper one is the SU. The empty bin keeps
+ * an SU and its multiple apart when thinned ACKs fill both.
+ */
+static void cesar_pattern_peaks(const struct cesar *cesar, u8 *index, u16 *value)
+{
+	u8 i, j, n = 0, max_bin = cesar_pattern_max_bin(cesar);
+	u8 run = 0;
 
-	u8 i;
-	u8 j;
-	u8 k;
-	u8 max;
-	u8 index;
-	
-	cesar->rtt_pattern[0] = 0;
-	cesar->rtt_pattern[1] = 0;
-	cesar->rtt_pattern[2] = 0;
-	cesar->rtt_pattern[4] = 0;
-	// find the 1~5th pattern index that appeared a lot (large_pattern_index) 
-	for(i = 0 ; i < MAX_SORTING ; i++){
-		max = cesar->rtt_pattern[0];
-		index = 0;
-		j = 0;
-		for (j = 5; j < MAX_PATTERN_COUNT; j++) {
-			if (cesar->rtt_pattern[j] > max) {
-				max = cesar->rtt_pattern[j];
-				index = j;
-			}
+	memset(index, 0, MAX_SORTING * sizeof(*index));
+	memset(value, 0, MAX_SORTING * sizeof(*value));
+
+	for (j = cesar_pattern_min_bin(cesar); j < max_bin; j++) {
+		u16 v = cesar_pattern_value(cesar, j);
+
+		if (!v) {
+			run = j + 1;
+			continue;
 		}
-		
-		large_pattern_index[i] = index;
-		large_pattern_value[i] = max;
 
-		cesar->rtt_pattern[index] = 0;
-		
-		if(index >= 4){
-			cesar->rtt_pattern[index-1] = 0;
-			cesar->rtt_pattern[index-2] = 0;
-			cesar->rtt_pattern[index-3] = 0;
-			cesar->rtt_pattern[index-4] = 0;
-		} else {
-			for (j = 0; j < index; j++) {
-				cesar->rtt_pattern[j] = 0;
+		for (i = 0; i < n; i++)
+			if (index[i] >= run && j - index[i] <= PATTERN_PEAK_SPREAD)
+				break;
+		if (i < n) {
+			if (v < value[i])
+				continue;
+			for (; i + 1 < n; i++) {
+				index[i] = index[i + 1];
+				value[i] = value[i + 1];
 			}
+			n--;
 		}
 
-		if(index <= MAX_PATTERN_COUNT - 5){
-			cesar->rtt_pattern[index+1] = 0;
-			cesar->rtt_pattern[index+2] = 0;
-			cesar->rtt_pattern[index+3] = 0;
-			cesar->rtt_pattern[index+4] = 0;
-		} else {
-			for (j = MAX_PATTERN_COUNT - 1; j > index; j--) {
-				cesar->rtt_pattern[j] = 0;
+		for (i = n; i > 0 && value[i - 1] < v; i--) {
+			if (i < MAX_SORTING) {
+				index[i] = index[i - 1];
+				value[i] = value[i - 1];
 			}
 		}
-	}
-	
-	// printk(KERN_WARNING "TEST: %d large_pattern i %u v %u i %u v %u i %u v %u \n", ntohs((tp->inet_conn).icsk_inet.inet_sport), 
-	// LINE_MARGIN * large_pattern_index[0],large_pattern_value[0],LINE_MARGIN * large_pattern_index[1],large_pattern_value[1],LINE_MARGIN * large_pattern_index[2],large_pattern_value[2]
-	// );
-
-	if(large_pattern_value[0] >= 8){
-		cesar->mode = CESAR_STEADY;
-		cesar->su = LINE_MARGIN * large_pattern_index[0];
-
-		if((large_pattern_index[0] == 10)){
-			if( (large_pattern_index[1] == 5)
-			&& (large_pattern_value[1] >= (large_pattern_value[0] / 2)) ){
-				cesar->su = 2500;
-			} else if( (large_pattern_index[2] == 5) 
-				&& (large_pattern_value[2] >= (large_pattern_value[0] / 2)) ){
-				cesar->su = 2500;
-			}
+		if (i < MAX_SORTING) {
+			index[i] = j;
+			value[i] = v;
+			n = min_t(u8, n + 1, MAX_SORTING);
 		}
+	}
+}
 
-		if((large_pattern_index[0] == 20)){
-			if(large_pattern_index[1] == 10){
-				cesar->su = 5000;
-			} else if((large_pattern_index[2] == 10) 
-				&& (large_pattern_value[2] >= (large_pattern_value[0] / 2))){
-				cesar->su = 5000;
-			}
-		}
+/* A strong peak at about half the top one is the real SU; the top one
+ * then counts the gaps where the cell skipped every other SU.
+ */
+static u8 cesar_pattern_fundamental(const u8 *index, const u16 *value)
+{
+	u8 i;
+
+	for (i = 1; i < MAX_SORTING; i++) {
+		if (value[i] && value[i] >= value[0] / 2 &&
+		    abs((int)index[i] * 2 - index[0]) <= 1)
+			return index[i];
+	}
+	return index[0];
+}
 
-		if(cesar->su == 4500){
-			cesar->su = 5000;
-		} else if(cesar->su == 7500){
-			cesar->su = 8000;
+/* How much of the histogram is periodic in su_idx: the share of scaled
+ * counts within a bin of a multiple of it, past what the same bins would
+ * hold if gaps were spread evenly, so noise scores 0 whatever the SU or
+ * bin layout.
+ */
+static u8 cesar_su_confidence(const struct cesar *cesar, u8 su_idx)
+{
+	u32 total = 0, periodic = 0, bins = 0, periodic_bins = 0;
+	u8 j, rem, min_bin = cesar_pattern_min_bin(cesar);
+	u8 max_bin = cesar_pattern_max_bin(cesar);
+	u64 excess, scale;
+
+	if (su_idx < min_bin)
+		return 0;
+
+	for (j = min_bin; j < max_bin; j++) {
+		u32 v = cesar_pattern_value(cesar, j);
+
+		bins++;
+		total += v;
+		rem = j % su_idx;
+		if (rem <= 1 || rem == su_idx - 1) {
+			periodic_bins++;
+			periodic += v;
 		}
+	}
 
-	} else {
-        if((large_pattern_value[0] == 0) || (large_pattern_value[1] == 0)){
-           cesar->mode = CESAR_BBR;
-           cesar->su = INITIAL_SU;
-        } else {
-            if((large_pattern_index[0] % large_pattern_index[1]) != 0){
-                if( ((large_pattern_index[0] % (large_pattern_index[1] + 1)) != 0)
-                &&  ((large_pattern_index[0] % (large_pattern_index[1] - 1)) != 0) ){
-                    cesar->mode = CESAR_BBR;
-                    cesar->su = INITIAL_SU;
-                }  
-            }
-        }
-    }
+	/* (periodic/total - periodic_bins/bins) / (1 - periodic_bins/bins) */
+	if (!total || periodic * bins <= total * periodic_bins)
+		return 0;
+	excess = (u64)periodic * bins - (u64)total * periodic_bins;
+	scale = (u64)total * (bins - periodic_bins);
+	return min_t(u64, div64_u64(excess << SU_CONF_SCALE, scale), SU_CONF_MAX);
+}
 
-	cesar_rtt_pattern_reset(sk);
+/* Peaks land a bin off when gaps smear across three or more bins, as they
+ * do once ACK thinning or stretch ACKs keep one ACK from anywhere in a
+ * burst; a bin off at the SU is k bins off at its k-th multiple. Take the
+ * neighbour whose multiples the histogram agrees with more.
+ */
+static u8 cesar_pattern_refine(const struct cesar *cesar, u8 su_idx)
+{
+	u8 best = su_idx, conf = cesar_su_confidence(cesar, su_idx);
+	u8 lo = su_idx - 1, hi = su_idx + 1;
 
+	if (su_idx > cesar_pattern_min_bin(cesar) &&
+	    cesar_su_confidence(cesar, lo) > conf) {
+		best = lo;
+		conf = cesar_su_confidence(cesar, lo);
+	}
+	if (hi < cesar_pattern_max_bin(cesar) &&
+	    cesar_su_confidence(cesar, hi) > conf)
+		best = hi;
+	return best;
 }
 
-void cesar_pattern_detection(struct sock *sk, const struct rate_sample *rs, u32 clock_diff)
+static void cesar_pattern_decision(struct sock *sk, const struct rate_sample *rs, u32 clock_diff)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
+	u8 large_pattern_index[MAX_SORTING];
+	u16 large_pattern_value[MAX_SORTING];
+	u32 bin_us = cesar_pattern_bin_us(cesar);
+	u8 su_idx, confidence, cur_idx = min_t(u32, cesar->su / bin_us, U8_MAX);
+
+	if(cesar->pattern_count < PATTERN_DECISION_PERIOD){
+		return;
+	}
+
+	cesar_pattern_peaks(cesar, large_pattern_index, large_pattern_value);
+	su_idx = cesar_pattern_fundamental(large_pattern_index, large_pattern_value);
+	su_idx = cesar_pattern_refine(cesar, su_idx);
+
+	/* Once locked, only move to an SU that clearly beats the current one
+	 * and is periodic enough to lock on by itself. Old bins lose half
+	 * their weight per decision, so after a handover this takes about two
+	 * decisions, and stray gaps cannot flip it. Halving the current SU
+	 * needs no majority: when ACKs are thinned to about one per SU, gaps
+	 * of twice the SU can outnumber the SU itself.
+	 */
+	confidence = cesar_su_confidence(cesar, su_idx);
+	if (cesar->mode == CESAR_STEADY && su_idx != cur_idx &&
+	    cur_idx < MAX_PATTERN_COUNT &&
+	    (confidence < SU_CONF_ENTER ||
+	     (cesar_pattern_value(cesar, su_idx) * 2 < cesar_pattern_value(cesar, cur_idx) * 3 &&
+	      abs((int)su_idx * 2 - cur_idx) > 1))) {
+		su_idx = cur_idx;
+		confidence = cesar_su_confidence(cesar, su_idx);
+	}
+
+	/* Smoothed over decisions so STEADY and BBR do not take turns */
+	cesar->su_confidence = (cesar->su_confidence * (SU_CONF_SMOOTH - 1) +
+				confidence + SU_CONF_SMOOTH / 2) / SU_CONF_SMOOTH;
+
+	cesar_stat_inc(sk, events[CESAR_STAT_SU_DECISIONS]);
+	if (cesar->mode == CESAR_STEADY) {
+		if (cesar->su_confidence < SU_CONF_EXIT) {
+			cesar_set_mode(sk, CESAR_BBR);
+			cesar->su = INITIAL_SU;
+			cesar_stat_inc(sk, events[CESAR_STAT_SU_FALLBACKS]);
+		} else {
+			if (su_idx != cur_idx)
+				cesar_stat_inc(sk, events[CESAR_STAT_SU_SWITCHES]);
+			cesar->su = su_idx * bin_us;
+		}
+	} else if (cesar->mode == CESAR_STARTUP || cesar->mode == CESAR_DRAIN) {
+		/* Let them finish; cesar_check_drain() hands over to STEADY */
+		if (large_pattern_value[0] >= PATTERN_PEAK_MIN &&
+		    cesar->su_confidence >= SU_CONF_ENTER)
+			cesar->su = su_idx * bin_us;
+	} else if (large_pattern_value[0] >= PATTERN_PEAK_MIN &&
+		   cesar->su_confidence >= SU_CONF_ENTER) {
+		/* ewma_bw and cwnd_est sat still through BBR; start from max_bw */
+		cesar_reset_steady_mode(sk, rs);
+		cesar->su = su_idx * bin_us;
+		cesar_stat_inc(sk, events[CESAR_STAT_SU_LOCKS]);
+	} else if (cesar->su_confidence < SU_CONF_EXIT) {
+		cesar_set_mode(sk, CESAR_BBR);
+		cesar->su = INITIAL_SU;
+	}
+
+	trace_cesar_su_decision(sk, large_pattern_index, large_pattern_value,
+				bin_us);
+	if (cesar->mode == CESAR_STEADY)
+		cesar_stat_inc(sk, su_hist[min_t(u32, cesar->su / LINE_MARGIN,
+						 CESAR_SU_HIST_BUCKETS - 1)]);
+
+	cesar_pattern_decay(cesar);
+	cesar->pattern_count = 0;
+}
+
+static void cesar_pattern_detection(struct sock *sk, const struct rate_sample *rs, u32 clock_diff)
 {
 	struct cesar *cesar = inet_csk_ca(sk);
-	struct tcp_sock *tp = tcp_sk(sk);
 	
+	u8 max_bin = cesar_pattern_max_bin(cesar);
 	u32 pattern_idx;
-	pattern_idx = (clock_diff / LINE_MARGIN);
+	pattern_idx = (clock_diff >> cesar->pattern_bin_shift) / PATTERN_BIN_MIN_US;
 	
-	if((pattern_idx >= MAX_PATTERN_COUNT)){
+	if((pattern_idx >= max_bin)){
 		return;
 	} else {
-		cesar->rtt_pattern[pattern_idx] += 1;
-		if(pattern_idx != (MAX_PATTERN_COUNT - 1)){
-			cesar->rtt_pattern[pattern_idx + 1] += 1;
+		cesar_pattern_inc(cesar, pattern_idx);
+		if(pattern_idx != (max_bin - 1)){
+			cesar_pattern_inc(cesar, pattern_idx + 1);
 		}
 		cesar->pattern_count += 1;
 	}
 }
 
-static void cesar_update_model(struct sock *sk, const struct rate_sample *rs)
+static void cesar_update_model(struct sock *sk, const struct rate_sample *rs, u32 bw)
 {
-	struct tcp_sock *tp = tcp_sk(sk);
-	struct cesar *cesar = inet_csk_ca(sk);
-
-	cesar_update_bw(sk, rs);
+	cesar_update_bw(sk, rs, bw);
 	cesar_check_full_bw_reached(sk, rs);
+	cesar_check_rtt_inflation(sk, rs);
 	cesar_check_drain(sk, rs);
 	cesar_update_min_rtt(sk, rs);
 }
 
-static void cesar_do_adjustment(struct sock *sk,  const struct rate_sample *rs, u32 current_clock, u32 ack){
+/* Weight of the fresh estimate when blending it into cwnd_est: cesar_beta
+ * percent as a 1/65536 fraction, so the blend is a multiply and a shift.
+ * CESAR_UNIT would round 5% down to 4.7%; the divide by a constant
+ * compiles to a multiply.
+ */
+#define CESAR_BETA_SCALE 16
+
+static u32 cesar_blend_cwnd(const struct sock *sk, u64 cwnd)
+{
+	const struct cesar *cesar = inet_csk_ca(sk);
+	u32 beta = ((u32)clamp(cesar_param(sk, beta), 0, 100) << CESAR_BETA_SCALE) / 100;
+
+	cwnd = min_t(u64, cwnd, U32_MAX);
+	return ((u64)cesar->cwnd_est * ((1U << CESAR_BETA_SCALE) - beta) + cwnd * beta)
+		>> CESAR_BETA_SCALE;
+}
+
+/* cwnd_est scaled to what fits min_rtt_us once queue_us more of delay
+ * is accounted for, i.e. cwnd_est * min_rtt / (min_rtt + queue_us).
+ */
+static u64 cesar_cwnd_at_min_rtt(const struct cesar *cesar, u64 queue_us)
+{
+	u64 rtt = cesar->min_rtt_us + queue_us;
+
+	if (unlikely(!rtt || rtt > U32_MAX))
+		return cesar->cwnd_est;
+	return div_u64((u64)cesar->cwnd_est * cesar->min_rtt_us, rtt);
+}
+
+/* With cesar_ecn, a CE mark shows a queue building before the RTT does.
+ * rs spans about the last round, so its CE share is that round's marking
+ * rate f; like DCTCP, cwnd_est gives up f / 2 per round, spread over the
+ * SUs in it as su / interval of that at each adjustment.
+ */
+static void cesar_ecn_reduce(struct sock *sk, const struct rate_sample *rs)
+{
 	struct cesar *cesar = inet_csk_ca(sk);
 	struct tcp_sock *tp = tcp_sk(sk);
+	u64 ce_frac, cut;
 
-	u64 scheduling_unit_bw = (u64)cesar->scheduling_unit_delivered * BW_UNIT;
-	do_div(scheduling_unit_bw, cesar->scheduling_unit_interval_us);
-	
-	u32 gain = 0;
-	if((rs->interval_us > (cesar->min_rtt_us + TMP * cesar->su))){
-		gain = 100 * (rs->interval_us - (cesar->min_rtt_us + TMP * cesar->su));
-		do_div(gain, (rs->interval_us));
-
-		u32 pacing_gain  = CESAR_UNIT;
-		pacing_gain = pacing_gain * (BASELINE - gain) / BASELINE;
-		cesar->pacing_gain = pacing_gain;
-	} 
-
-	if(
-	(cesar->previous_rtt <= cesar->previous_previous_rtt)
-	)
-	{
-		u32 current_cwnd = cesar->cwnd_est;
-		u64 amount_of_modification = 0;
+	if (!READ_ONCE(cesar_ecn) || rs->delivered_ce <= 0 || rs->delivered <= 0 ||
+	    rs->interval_us <= 0)
+		return;
 
-		amount_of_modification = cesar->ewma_bw;
+	ce_frac = div_u64((u64)min(rs->delivered_ce, rs->delivered) << CESAR_SCALE,
+			  rs->delivered);
+	cut = (u64)cesar->cwnd_est * ce_frac * min_t(u64, cesar->su, rs->interval_us);
+	cut = div64_u64(cut, (u64)rs->interval_us << (CESAR_SCALE + 1));
 
+	cesar->cwnd_est = max_t(u64, cesar->cwnd_est - cut,
+				cesar_cwnd_min_target * tp->advmss);
+	cesar_stat_inc(sk, events[CESAR_STAT_ECN_CUTS]);
+}
 
-		if((rs->interval_us > (cesar->min_rtt_us + TMP * cesar->su))){
-			amount_of_modification = amount_of_modification * (BASELINE - gain) / BASELINE;
-		} 
+/* Flows to one peer mostly share its radio bearer, and with it su,
+ * min_rtt and capacity; a phone opening six connections would otherwise
+ * learn them six times and have six flows each size cwnd_est for the
+ * whole bearer. With cesar_share, flows publish what they locked on in a
+ * per-netns table keyed by IPv4 address or IPv6 /64, and a flow that
+ * starts while its entry is fresh takes su, min_rtt and its share of the
+ * bandwidth from it and begins in STEADY; the pattern detector keeps
+ * checking the su it was handed. Flows that run together cap cwnd_est at
+ * a fair share of the bearer's BDP, so each SU's budget is split rather
+ * than claimed in full by every flow. Behind CGNAT one IPv4 address can
+ * stand for many bearers, hence off by default.
+ */
+#ifndef CESAR_BPF
+static bool cesar_dst_key(const struct sock *sk, u64 *prefix, u16 *family)
+{
+	switch (sk->sk_family) {
+	case AF_INET:
+		*prefix = ntohl(sk->sk_daddr);
+		*family = AF_INET;
+		return true;
+#if IS_ENABLED(CONFIG_IPV6)
+	case AF_INET6:
+		if (ipv6_addr_v4mapped(&sk->sk_v6_daddr)) {
+			*prefix = ntohl(sk->sk_v6_daddr.s6_addr32[3]);
+			*family = AF_INET;
+		} else {
+			*prefix = (u64)ntohl(sk->sk_v6_daddr.s6_addr32[0]) << 32 |
+				  ntohl(sk->sk_v6_daddr.s6_addr32[1]);
+			*family = AF_INET6;
+		}
+		return true;
+#endif
+	}
+	return false;
+}
 
-		amount_of_modification *= (cesar->su);
+/* Under rcu_read_lock() */
+static struct cesar_dst *cesar_dst_lookup(struct cesar_net *cn, u64 prefix,
+					  u16 family)
+{
+	struct cesar_dst *d;
 
-		amount_of_modification *= tp->advmss;
-		amount_of_modification >>= BW_SCALE;
-		
-		amount_of_modification *= cesar->previous_previous_rtt - cesar->previous_rtt;
-
-		do_div(amount_of_modification, cesar->previous_previous_rtt - cesar->min_rtt_us);
-
-		if((cesar->ewma_bw > cesar->previous_bw)
-		){
-			u64 over_rtt = 0;
-			u64 beta = CESAR_SMALL_UNIT * cesar_beta;
-
-			u64 cwnd_origin = cesar->cwnd_est;
-			u64 cwnd =  cesar->cwnd_est;
-
-			cwnd *= cesar->min_rtt_us;
-			
-			u64 over_rtt_tmp = 0;
-			
-			if(cesar->previous_rtt > cesar->min_rtt_us)
-				over_rtt_tmp = cesar->previous_rtt - cesar->min_rtt_us;
-
-            over_rtt_tmp *= cesar->ewma_bw - cesar->previous_bw;
-            do_div(over_rtt_tmp, cesar->ewma_bw);
-			
-			do_div(cwnd, cesar->min_rtt_us + over_rtt_tmp);
-
-			cwnd *= beta;
-			cwnd >>= CESAR_SMALL_SCALE;
-			do_div(cwnd, 100);
-
-			cwnd_origin *= (100 * CESAR_SMALL_UNIT -beta);
-			do_div(cwnd_origin, 100 * CESAR_SMALL_UNIT);
-			
-			cesar->cwnd_est = cwnd_origin + cwnd;
+	hash_for_each_possible_rcu(cn->dst_hash, d, node, prefix)
+		if (d->prefix == prefix && d->family == family)
+			return d;
+	return NULL;
+}
+
+static bool cesar_dst_fresh(const struct cesar_dst *d)
+{
+	return atomic_read(&d->flows) ||
+	       time_before(jiffies, READ_ONCE(d->stamp) + CESAR_DST_TTL);
+}
+
+static void cesar_dst_free(struct cesar_net *cn, struct cesar_dst *d)
+{
+	hash_del_rcu(&d->node);
+	kfree_rcu(d, rcu);
+	cn->dst_count--;
+}
+
+/* Under dst_lock: drop idle entries in prefix's bucket, or in the whole
+ * table once it is full.
+ */
+static void cesar_dst_reclaim(struct cesar_net *cn, u64 prefix)
+{
+	struct hlist_node *tmp;
+	struct cesar_dst *d;
+	int bkt;
+
+	hash_for_each_possible_safe(cn->dst_hash, d, tmp, node, prefix)
+		if (!cesar_dst_fresh(d))
+			cesar_dst_free(cn, d);
+	if (cn->dst_count < CESAR_DST_MAX)
+		return;
+	hash_for_each_safe(cn->dst_hash, bkt, tmp, d, node)
+		if (!cesar_dst_fresh(d))
+			cesar_dst_free(cn, d);
+}
+
+/* Start from what other flows to this destination know: fair share of
+ * the bearer, their min_rtt and su, straight into STEADY.
+ */
+static void cesar_dst_seed(struct sock *sk, const struct cesar_dst *d, u32 flows)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 su = READ_ONCE(d->su), min_rtt_us = READ_ONCE(d->min_rtt_us);
+	u32 bw = READ_ONCE(d->bw);
+
+	if (!su || !min_rtt_us || !bw)
+		return;
+
+	cesar->min_rtt_us = min_rtt_us;
+	cesar->min_rtt_stamp = tcp_jiffies32;
+	cesar->su = su;
+	cesar->su_confidence = SU_CONF_ENTER;
+	minmax_reset(&cesar->bw, cesar->rtt_cnt, max(bw / flows, 1U));
+	cesar->full_bw_reached = 1;
+	cesar_reset_steady_mode(sk, NULL);
+	cesar->cwnd_est = cesar_bdp(sk) * tp->advmss;
+	cesar->previous_bw = cesar->ewma_bw;
+	cesar_stat_inc(sk, events[CESAR_STAT_DST_SEEDS]);
+}
+
+static void cesar_dst_get(struct sock *sk)
+{
+	struct cesar_net *cn = net_generic(sock_net(sk), cesar_net_id);
+	struct cesar *cesar = inet_csk_ca(sk);
+	struct cesar_dst *d;
+	u32 flows = 0;
+	u64 prefix;
+	u16 family;
+
+	if (!cesar_param(sk, share) || !cesar_dst_key(sk, &prefix, &family))
+		return;
+
+	/* Once per connection, so a lock around the whole thing is fine */
+	rcu_read_lock();
+	spin_lock_bh(&cn->dst_lock);
+	d = cesar_dst_lookup(cn, prefix, family);
+	if (d && !cesar_dst_fresh(d)) {
+		WRITE_ONCE(d->su, 0);
+		WRITE_ONCE(d->min_rtt_us, 0);
+		WRITE_ONCE(d->bw, 0);
+	}
+	if (!d) {
+		cesar_dst_reclaim(cn, prefix);
+		d = cn->dst_count < CESAR_DST_MAX ?
+		    kzalloc(sizeof(*d), GFP_ATOMIC) : NULL;
+		if (d) {
+			d->prefix = prefix;
+			d->family = family;
+			d->stamp = jiffies;
+			hash_add_rcu(cn->dst_hash, &d->node, prefix);
+			cn->dst_count++;
 		}
+	}
+	if (d) {
+		flows = atomic_inc_return(&d->flows);
+		cesar->dst_shared = 1;
+		cesar_dst_seed(sk, d, flows);
+	}
+	spin_unlock_bh(&cn->dst_lock);
+	rcu_read_unlock();
+}
 
-		cesar->cwnd_est += amount_of_modification;
+/* Once per SU in STEADY: publish what this flow knows, and keep cwnd_est
+ * within a quarter over its share of the bearer's BDP.
+ */
+static void cesar_dst_sync(struct sock *sk)
+{
+	struct cesar_net *cn = net_generic(sock_net(sk), cesar_net_id);
+	struct cesar *cesar = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct cesar_dst *d;
+	u32 flows, bw;
+	u64 prefix, cap;
+	u16 family;
 
-		cesar->cwnd_est = max(current_cwnd, cesar->cwnd_est);
-	} else if(		
-	(cesar->previous_rtt > cesar->previous_previous_rtt)
-	){
-		u64 over_rtt = 0;
-		u64 beta = CESAR_SMALL_UNIT * cesar_beta;
+	if (!cesar->dst_shared || !cesar_dst_key(sk, &prefix, &family))
+		return;
 
-		u64 cwnd_origin = cesar->cwnd_est;
-		u64 cwnd =  cesar->cwnd_est;
+	rcu_read_lock();
+	d = cesar_dst_lookup(cn, prefix, family);
+	if (!d)
+		goto out;
+	flows = max(atomic_read(&d->flows), 1);
+	bw = READ_ONCE(d->bw);
+	if (cesar->mode == CESAR_STEADY && cesar->ewma_bw &&
+	    (cesar_param(sk, scheduling_unit) ||
+	     cesar->su_confidence >= SU_CONF_ENTER)) {
+		u64 total = (u64)cesar->ewma_bw * flows;
+
+		bw = bw ? min_t(u64, ((u64)bw * 3 + total) >> 2, U32_MAX) :
+			  min_t(u64, total, U32_MAX);
+		WRITE_ONCE(d->su, cesar->su);
+		WRITE_ONCE(d->min_rtt_us, cesar->min_rtt_us);
+		WRITE_ONCE(d->bw, bw);
+		WRITE_ONCE(d->stamp, jiffies);
+	}
+	if (flows > 1 && bw) {
+		cap = (u64)bw / flows * cesar->min_rtt_us;
+		cap = ((cap + BW_UNIT - 1) >> BW_SCALE) * tp->advmss;
+		cap = max_t(u64, cap + (cap >> 2), cesar_cwnd_min_target * tp->advmss);
+		cesar->cwnd_est = min_t(u64, cesar->cwnd_est, cap);
+	}
+out:
+	rcu_read_unlock();
+}
 
-		cwnd *= cesar->min_rtt_us;
-		
-		u64 over_rtt_tmp = 0;
+static void cesar_dst_put(struct sock *sk)
+{
+	struct cesar_net *cn = net_generic(sock_net(sk), cesar_net_id);
+	struct cesar *cesar = inet_csk_ca(sk);
+	struct cesar_dst *d;
+	u64 prefix;
+	u16 family;
 
-		over_rtt = cesar->previous_rtt - cesar->previous_previous_rtt;
-		
-		if(cesar->previous_rtt > cesar->min_rtt_us)
-			over_rtt_tmp = cesar->previous_rtt - cesar->min_rtt_us;
+	if (!cesar->dst_shared || !cesar_dst_key(sk, &prefix, &family))
+		return;
 
-		if(cesar->ewma_bw > cesar->previous_bw){
-			over_rtt_tmp *= cesar->ewma_bw - cesar->previous_bw;
-			do_div(over_rtt_tmp, cesar->ewma_bw);
-		} else {
-			over_rtt_tmp = 0;
+	rcu_read_lock();
+	d = cesar_dst_lookup(cn, prefix, family);
+	if (d) {
+		WRITE_ONCE(d->stamp, jiffies);
+		atomic_dec(&d->flows);
+	}
+	rcu_read_unlock();
+	cesar->dst_shared = 0;
+}
+
+static void cesar_dst_flush(struct cesar_net *cn)
+{
+	struct hlist_node *tmp;
+	struct cesar_dst *d;
+	int bkt;
+
+	hash_for_each_safe(cn->dst_hash, bkt, tmp, d, node) {
+		hash_del_rcu(&d->node);
+		kfree(d);
+	}
+	cn->dst_count = 0;
+}
+#else
+static void cesar_dst_get(struct sock *sk) { }
+static void cesar_dst_sync(struct sock *sk) { }
+static void cesar_dst_put(struct sock *sk) { }
+#endif
+
+static void cesar_do_adjustment(struct sock *sk,  const struct rate_sample *rs, u32 current_clock, u32 ack){
+	struct cesar *cesar = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 old_cwnd_est = cesar->cwnd_est;
+	u32 queue_us = 0;
+	u64 scheduling_unit_bw = 0;
+	u32 gain = CESAR_UNIT, gamma;
+
+	if (likely(cesar->scheduling_unit_interval_us))
+		scheduling_unit_bw = div_u64((u64)cesar->scheduling_unit_delivered * BW_UNIT,
+					     cesar->scheduling_unit_interval_us);
+
+	if (cesar->previous_rtt > cesar->min_rtt_us)
+		queue_us = cesar->previous_rtt - cesar->min_rtt_us;
+
+	/* Pace below ewma_bw by half the share of the interval spent queueing */
+	if (rs->interval_us > cesar->min_rtt_us + TMP * cesar->su) {
+		u32 interval_us = rs->interval_us;
+		u32 excess_us = interval_us - (cesar->min_rtt_us + TMP * cesar->su);
+
+		gain = CESAR_UNIT - (u32)div_u64((u64)excess_us << (CESAR_SCALE - 1), interval_us);
+		cesar->pacing_gain = gain;
+	}
+
+	if (cesar->previous_rtt <= cesar->previous_previous_rtt) {
+		u32 current_cwnd = cesar->cwnd_est;
+		u64 amount_of_modification = 0;
+
+		/* Grow by the share of the last RTT drop still left to drain */
+		if (likely(cesar->previous_previous_rtt > cesar->min_rtt_us)) {
+			amount_of_modification = ((u64)cesar->ewma_bw * gain) >> CESAR_SCALE;
+			amount_of_modification *= (u64)cesar->su * tp->advmss;
+			amount_of_modification >>= BW_SCALE;
+			amount_of_modification *= cesar->previous_previous_rtt - cesar->previous_rtt;
+			amount_of_modification = div_u64(amount_of_modification,
+				cesar->previous_previous_rtt - cesar->min_rtt_us);
 		}
 
-		if(cesar->previous_bw > scheduling_unit_bw){
-        	over_rtt *= scheduling_unit_bw;
-        	do_div(over_rtt, cesar->previous_bw);
+		if (cesar->ewma_bw > cesar->previous_bw) {
+			u64 over_rtt_tmp = div_u64((u64)queue_us * (cesar->ewma_bw - cesar->previous_bw),
+						   cesar->ewma_bw);
+
+			cesar->cwnd_est = cesar_blend_cwnd(sk,
+				cesar_cwnd_at_min_rtt(cesar, over_rtt_tmp));
 		}
-		
 
-		do_div(cwnd, cesar->min_rtt_us + over_rtt_tmp + over_rtt);
+		cesar->cwnd_est = min_t(u64, (u64)cesar->cwnd_est + amount_of_modification, U32_MAX);
 
-		cwnd *= beta;
-		cwnd >>= CESAR_SMALL_SCALE;
-		do_div(cwnd, 100);
+		cesar->cwnd_est = max(current_cwnd, cesar->cwnd_est);
+	} else {
+		u64 over_rtt = cesar->previous_rtt - cesar->previous_previous_rtt;
+		u64 over_rtt_tmp = 0;
 
-		cwnd_origin *= (100 * CESAR_SMALL_UNIT -beta);
-		do_div(cwnd_origin, 100 * CESAR_SMALL_UNIT);
-		
-		cesar->cwnd_est = cwnd_origin + cwnd;
-		
-	} 
+		if (cesar->ewma_bw > cesar->previous_bw)
+			over_rtt_tmp = div_u64((u64)queue_us * (cesar->ewma_bw - cesar->previous_bw),
+					       cesar->ewma_bw);
+
+		if (cesar->previous_bw > scheduling_unit_bw)
+			over_rtt = div_u64(over_rtt * scheduling_unit_bw, cesar->previous_bw);
 
-	cesar->ewma_bw -= cesar->ewma_bw / cesar_gamma;
-	cesar->ewma_bw += cesar->previous_bw / cesar_gamma;
+		cesar->cwnd_est = cesar_blend_cwnd(sk,
+			cesar_cwnd_at_min_rtt(cesar, over_rtt_tmp + over_rtt));
+	}
+
+	cesar_ecn_reduce(sk, rs);
+	cesar_dst_sync(sk);
+
+	/* ewma_bw += (previous_bw - ewma_bw) / gamma, rounded towards zero
+	 * with an unsigned divide: BPF before v4 has no signed one.
+	 */
+	gamma = max(cesar_param(sk, gamma), 1);
+	if (cesar->previous_bw >= cesar->ewma_bw)
+		cesar->ewma_bw += (cesar->previous_bw - cesar->ewma_bw) / gamma;
+	else
+		cesar->ewma_bw -= (cesar->ewma_bw - cesar->previous_bw) / gamma;
+
+	trace_cesar_cwnd_adjust(sk, old_cwnd_est, scheduling_unit_bw);
 
 	cesar->previous_previous_rtt = cesar->previous_rtt;
 }
 
+static void cesar_su_delivered_add(struct cesar *cesar)
+{
+	cesar->scheduling_unit_delivered = min_t(u32, U16_MAX,
+		cesar->scheduling_unit_delivered + cesar->previous_ack);
+}
+
 static void cesar_do_reset(struct sock *sk,  const struct rate_sample *rs){
 	struct cesar *cesar = inet_csk_ca(sk);
-	struct tcp_sock *tp = tcp_sk(sk);
 
 	cesar->gathering_current_scheduling_unit = 0;
 	cesar->scheduling_unit_interval_us = 0;
@@ -661,36 +1520,39 @@ static void cesar_do_reset(struct sock *sk,  const struct rate_sample *rs){
 	cesar->clock_pass = 0;
 }
 
-static void cesar_scheduling_unit_adjust(struct sock *sk, const struct rate_sample *rs,u32 current_clock, u32 ack)
+/* Two bins of slack around su, or one for SUs of up to six bins. Never
+ * more than half of su, so su - margin cannot wrap for a small fixed su.
+ */
+static u32 cesar_su_margin(const struct cesar *cesar)
+{
+	u32 bin_us = cesar_pattern_bin_us(cesar);
+
+	return min(cesar->su <= 6 * bin_us ? bin_us : bin_us * 2, cesar->su / 2U);
+}
+
+static void cesar_scheduling_unit_adjust(struct sock *sk, const struct rate_sample *rs,u32 current_clock, u32 ack, u32 bw)
 {
 	struct cesar *cesar = inet_csk_ca(sk);
-	struct tcp_sock *tp = tcp_sk(sk);
 	
 	if(!(rs->rtt_us > 0) || !(cesar->previous_rtt > 0) || (cesar->min_rtt_us > rs->rtt_us)){
 		return;
 	}
 
-	if(cesar_scheduling_unit == 0){
+	if(cesar_param(sk, scheduling_unit) == 0){
 		cesar_pattern_detection(sk,rs,current_clock -cesar->previous_clock);
 		cesar_pattern_decision(sk,rs,current_clock -cesar->previous_clock);
 	} else {
-		cesar->su = cesar_scheduling_unit;
+		cesar->su = cesar_param(sk, scheduling_unit);
 	}
 
-	u64 bw = 0;
-	bw = (u64)rs->delivered * BW_UNIT;
-	do_div(bw, rs->interval_us);
-
 	if((cesar->mode != CESAR_STEADY)){
 		cesar->previous_clock = current_clock;
 		return;
 	}
 
 
-	u32 margin = LINE_MARGIN * 2;
-	if(cesar->su <= 3000){
-		margin = LINE_MARGIN;
-	}
+	u32 line_margin = cesar_pattern_bin_us(cesar);
+	u32 margin = cesar_su_margin(cesar);
 	bool clock_saving = 0;
 	u32 previous_clock_diff = cesar->previous_clock_diff;
 	u32 current_clock_diff = current_clock - cesar->previous_clock;	
@@ -699,14 +1561,15 @@ static void cesar_scheduling_unit_adjust(struct sock *sk, const struct rate_samp
 
 	if((previous_clock_diff >= (cesar->su - margin))
 	&& (current_clock_diff < (cesar->su - margin))){
-		cesar->scheduling_unit_delivered += cesar->previous_ack;
-		cesar->scheduling_unit_interval_us = ((previous_clock_diff + margin) / cesar->su) * cesar->su;
+		u32 su_interval_us = ((previous_clock_diff + margin) / cesar->su) * cesar->su;
+
+		cesar_su_delivered_add(cesar);
 		cesar->gathering_current_scheduling_unit = 1;
 
-		if((abs(cesar->previous_clock_diff - cesar->scheduling_unit_interval_us) > margin)
-		&& (cesar->previous_clock_diff >= (cesar->su + LINE_MARGIN))
-		&& (cesar->previous_clock_diff > cesar->scheduling_unit_interval_us)){
-			cesar->clock_pass +=  cesar->previous_clock_diff - cesar->scheduling_unit_interval_us;
+		if((abs(cesar->previous_clock_diff - su_interval_us) > margin)
+		&& (cesar->previous_clock_diff >= (cesar->su + line_margin))
+		&& (cesar->previous_clock_diff > su_interval_us)){
+			cesar->clock_pass +=  cesar->previous_clock_diff - su_interval_us;
 		}
 
 		// testing
@@ -714,8 +1577,7 @@ static void cesar_scheduling_unit_adjust(struct sock *sk, const struct rate_samp
 
 	} else if((previous_clock_diff >= (cesar->su - margin))
 	&& (current_clock_diff >= (cesar->su - margin))){
-		cesar->scheduling_unit_delivered += cesar->previous_ack;
-		cesar->scheduling_unit_interval_us = (( previous_clock_diff + margin) / cesar->su) * cesar->su;
+		cesar_su_delivered_add(cesar);
 		
 		// testing
 		cesar->scheduling_unit_interval_us = previous_clock_diff;
@@ -726,7 +1588,7 @@ static void cesar_scheduling_unit_adjust(struct sock *sk, const struct rate_samp
 	} else if((previous_clock_diff < (cesar->su - margin))
 	&& (current_clock_diff >= (cesar->su - margin))){
 		if(cesar->gathering_current_scheduling_unit){
-			cesar->scheduling_unit_delivered += cesar->previous_ack;
+			cesar_su_delivered_add(cesar);
 			cesar_do_adjustment(sk,rs,current_clock,ack);
 			cesar_do_reset(sk,rs);
 			if((current_clock - cesar->previous_clock) < (cesar->su - margin)){
@@ -737,7 +1599,7 @@ static void cesar_scheduling_unit_adjust(struct sock *sk, const struct rate_samp
 	} else if((previous_clock_diff < (cesar->su - margin))
 	&& (current_clock_diff < (cesar->su - margin))){
 		if(cesar->gathering_current_scheduling_unit){
-			cesar->scheduling_unit_delivered += cesar->previous_ack;
+			cesar_su_delivered_add(cesar);
 			cesar->clock_pass +=  cesar->previous_clock_diff;
 		}
 	}
@@ -750,55 +1612,188 @@ static void cesar_scheduling_unit_adjust(struct sock *sk, const struct rate_samp
 		cesar->previous_clock_diff = current_clock_diff;
 	else
 		cesar->previous_clock_diff = current_clock - cesar->previous_clock;
-	cesar->previous_ack = ack;
+	cesar->previous_ack = min_t(u32, ack, U16_MAX);
 	cesar->previous_clock = current_clock;
-	cesar->previous_bw = bw;
+	/* An app-limited sample says how much we sent, not what the link
+	 * carries: keep it out of ewma_bw unless it shows more.
+	 */
+	if (!rs->is_app_limited || bw >= cesar->ewma_bw)
+		cesar->previous_bw = bw;
 	cesar->previous_rtt = rs->rtt_us;
 }
 
-static void cesar_main(struct sock *sk, const struct rate_sample *rs)
+/* SU-aligned pacing, opt-in through cesar_su_pacing. An ACK that opens a
+ * burst reports an SU the cell served about min_rtt ago, so data leaving
+ * on the grid now - min_rtt + k * su gets to the cell as an SU starts.
+ * cwnd already caps a round of SUs at what they delivered; this shapes when
+ * it leaves: the next departure is held to su / SU_BURST_DIV before a grid
+ * point and the budget is paced out at SU_BURST_DIV times the rate, so it
+ * sits at the cell for a fraction of an SU instead of half of one.
+ */
+static bool cesar_su_pacing(struct sock *sk)
+{
+#ifdef CESAR_BPF
+	/* struct_ops may not move tcp_wstamp_ns, see cesar_su_hold() */
+	return false;
+#else
+	struct cesar *cesar = inet_csk_ca(sk);
+
+	return cesar_param(sk, su_pacing) && cesar->mode == CESAR_STEADY &&
+	       cesar->su && cesar->min_rtt_us != ~0U;
+#endif
+}
+
+static void cesar_su_hold(struct sock *sk, u32 gap_us)
 {
 	struct cesar *cesar = inet_csk_ca(sk);
 	struct tcp_sock *tp = tcp_sk(sk);
-	u32 bw;
+	u32 su = cesar->su, hold_us;
+	u64 next_ns;
 
-	cesar_update_model(sk, rs);
+	/* Only the first ACK of a burst dates the grid */
+	if (gap_us + cesar_su_margin(cesar) < su)
+		return;
 
-	if(cesar_mode_outside == 1){
-		printk(KERN_WARNING "DEBUG: %d %u rtt %u min %u current_clock %u previous_rtt %u period %u ewma %d max %u bound_max %u inter %u deliver %u clock %u snd %u condition %u pacing %u beta %u g %u ack %u mss %u app %u %u | %d \n", ntohs((tp->inet_conn).icsk_inet.inet_sport), 
-		cesar->cwnd_est, rs->rtt_us, cesar->min_rtt_us, 
-		tp->tcp_mstamp, cesar->previous_rtt, 
-		cesar->su, cesar->ewma_bw, cesar_max_bw(sk), 0,
-		rs->interval_us, rs->delivered, tp->tcp_mstamp - cesar->previous_clock , tp->snd_cwnd,0,sk->sk_pacing_rate, 0,
-		cesar->pacing_gain,rs->acked_sacked,tp->advmss, 
-		rs->is_app_limited, 0,
-		cesar->mode);
+	hold_us = (su - cesar->min_rtt_us % su) % su;
+	hold_us = (hold_us + su - su / SU_BURST_DIV) % su;
+	next_ns = tp->tcp_clock_cache + (u64)hold_us * NSEC_PER_USEC;
+	if (next_ns > tp->tcp_wstamp_ns)
+		tp->tcp_wstamp_ns = next_ns;
+}
+
+/* First ACK after an app-limited idle, see cesar_cwnd_event(): the SU
+ * grid restarts from it, rather than counting the idle gap as one long SU
+ * that delivered next to nothing.
+ */
+static void cesar_idle_resync(struct sock *sk, const struct rate_sample *rs)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (likely(!cesar->idle_restart) || rs->delivered <= 0)
+		return;
+
+	cesar->idle_restart = 0;
+	cesar->previous_clock = tp->tcp_mstamp;
+	if (cesar->mode != CESAR_STARTUP) {	/* the SU fields are in use */
+		cesar_do_reset(sk, rs);
+		cesar->previous_clock_diff = 0;
 	}
+}
+
+#ifdef CESAR_BPF
+#define cesar_capture(sk, rs) do { } while (0)
+#else
+static bool cesar_capture_wanted(const struct sock *sk)
+{
+	int port = READ_ONCE(cesar_capture_port);
+	u64 cookie = READ_ONCE(cesar_capture_cookie);
+
+	if (port < 0)
+		return true;
+	if (port && (port == ntohs(inet_sk(sk)->inet_sport) ||
+		     port == ntohs(inet_sk(sk)->inet_dport)))
+		return true;
+	/* only set once someone asked for it, as ss -e or sock_diag do */
+	return cookie && cookie == atomic64_read(&sk->sk_cookie);
+}
+
+/* One binary record per ACK, after Cesar has acted on it. A full buffer
+ * drops the record and counts it, see cesar_capture_subbuf_start().
+ */
+static void cesar_capture(struct sock *sk, const struct rate_sample *rs)
+{
+	const struct cesar *cesar = inet_csk_ca(sk);
+	const struct tcp_sock *tp = tcp_sk(sk);
+	struct cesar_sample s;
 
-    cesar_scheduling_unit_adjust(sk,rs,tp->tcp_mstamp,rs->acked_sacked);
+	if (likely(!cesar_capture_chan) || !cesar_capture_wanted(sk))
+		return;
+
+	s = (struct cesar_sample) {
+		.time_us	= tp->tcp_mstamp,
+		.pacing_rate	= READ_ONCE(sk->sk_pacing_rate),
+		.sport		= ntohs(inet_sk(sk)->inet_sport),
+		.dport		= ntohs(inet_sk(sk)->inet_dport),
+		.su		= cesar->su,
+		.mode		= cesar->mode,
+		.flags		= (rs->is_app_limited ? CESAR_SAMPLE_APP_LIMITED : 0) |
+				  (rs->losses > 0 ? CESAR_SAMPLE_LOSS : 0),
+		.rtt_us		= rs->rtt_us,
+		.interval_us	= rs->interval_us,
+		.delivered	= rs->delivered,
+		.acked_sacked	= rs->acked_sacked,
+		.cwnd_est	= cesar->cwnd_est,
+		.snd_cwnd	= tp->snd_cwnd,
+		.min_rtt_us	= cesar->min_rtt_us,
+		.ewma_bw	= cesar->ewma_bw,
+	};
+	relay_write(cesar_capture_chan, &s, sizeof(s));
+}
+#endif
+
+static void cesar_main(struct sock *sk, const struct rate_sample *rs)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 bw, sample_bw = cesar_sample_bw(rs);
+	u32 gap_us = tp->tcp_mstamp - cesar->previous_clock;
+	int gain;
+
+	cesar_update_model(sk, rs, sample_bw);
+	cesar_idle_resync(sk, rs);
+
+	trace_cesar_ack(sk, rs);
+
+    cesar_scheduling_unit_adjust(sk,rs,tp->tcp_mstamp,rs->acked_sacked,sample_bw);
 
 	bw = cesar_ewma_bw_alpha(sk,rs);
 
     if(cesar->mode == CESAR_BBR){
         cesar->pacing_gain = CESAR_UNIT;
     }
-	cesar_set_pacing_rate(sk, bw, cesar->pacing_gain,rs);
+	gain = cesar->pacing_gain;
+	if (cesar_su_pacing(sk)) {
+		gain *= SU_BURST_DIV;
+		cesar_su_hold(sk, gap_us);
+	}
+	cesar_set_pacing_rate(sk, bw, gain,rs);
 	cesar_set_cwnd(sk, rs, rs->acked_sacked, bw, cesar_cwnd_gain);
+	cesar_capture(sk, rs);
+}
+
+#ifdef CESAR_BPF
+/* One struct_ops, one profile: cesar_bpf always runs profile 0 */
+static u8 cesar_pick_profile(const struct sock *sk)
+{
+	return 0;
+}
+#else
+static struct tcp_congestion_ops tcp_cesar_cong_ops[CESAR_NR_PROFILES] __read_mostly;
+
+/* The profile is the one named by the congestion control the socket chose */
+static u8 cesar_pick_profile(const struct sock *sk)
+{
+	return inet_csk(sk)->icsk_ca_ops - tcp_cesar_cong_ops;
 }
+#endif
 
 static void cesar_init(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct cesar *cesar = inet_csk_ca(sk);
 
-	cesar->tso_segs_goal = 0;	
+	cesar->profile = cesar_pick_profile(sk);
+	cesar->pattern_bin_shift = cesar_pattern_bin_shift(cesar_param(sk, pattern_bin_us));
 	cesar->rtt_cnt = 0;
 	cesar->next_rtt_delivered = 0;
 	cesar->prev_ca_state = TCP_CA_Open;
 	cesar->packet_conservation = 0;
 
 	cesar->min_rtt_us = 100000;
-	// cesar->min_rtt_stamp = tcp_jiffies32;
+	cesar->min_rtt_stamp = tcp_jiffies32;
+	cesar->probe_rtt = 0;
+	cesar->probe_rtt_round_done = 0;
 
 	minmax_reset(&cesar->bw, cesar->rtt_cnt, 0); 
 
@@ -807,17 +1802,12 @@ static void cesar_init(struct sock *sk)
 	cesar->full_bw_reached = 0;
 	cesar->ewma_bw = 0;
 	cesar->full_bw_cnt = 0;
-	cesar->cycle_idx = 0;
 	cesar_reset_startup_mode(sk);
 
 	cesar->cwnd_est = 1 * tp->advmss;
 
 	cesar->su = INITIAL_SU;
 
-	cesar->pattern_decision_count = 0;
-
-	cesar->su_found = 0;
-
 	cesar->previous_rtt = 100000;
 
 	cesar->previous_clock = 1;
@@ -828,28 +1818,24 @@ static void cesar_init(struct sock *sk)
 
 	cesar->previous_bw = 0;
 
-	cesar->rtt_pattern = (u8*)kmalloc(MAX_PATTERN_COUNT * sizeof(u8), GFP_KERNEL);
-	if (!(cesar->rtt_pattern)) {
-    	printk(KERN_WARNING "DEBUG: %d could not allocate array memory\n", ntohs((tp->inet_conn).icsk_inet.inet_sport));
-    } else {
-		printk(KERN_WARNING "DEBUG: %d successfully allocate array memory\n", ntohs((tp->inet_conn).icsk_inet.inet_sport));
-    
-	}
-    memset(cesar->rtt_pattern, 0, MAX_PATTERN_COUNT * sizeof(u8));
 	cesar_rtt_pattern_reset(sk);
+	cesar->dst_shared = 0;
+	cesar->idle_restart = 0;
+	cesar->rto_pending = 0;
+	trace_cesar_init(sk);
+	cesar_stat_inc(sk, events[CESAR_STAT_FLOWS]);
+	cesar_dst_get(sk);
 
 	cmpxchg(&sk->sk_pacing_status, SK_PACING_NONE, SK_PACING_NEEDED);
 }
 
-void cesar_release(struct sock *sk) {
-    struct cesar *cesar = inet_csk_ca(sk);
-    struct tcp_sock *tp = tcp_sk(sk);
-	
-    if (cesar->rtt_pattern != NULL) {
-        kfree(cesar->rtt_pattern);
-        cesar->rtt_pattern = NULL;
-		printk(KERN_WARNING "DEBUG: %d release memory\n", ntohs((tp->inet_conn).icsk_inet.inet_sport));
-    }
+static void cesar_release(struct sock *sk)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
+
+	trace_cesar_release(sk);
+	cesar_stat_inc(sk, released[cesar->mode]);
+	cesar_dst_put(sk);
 }
 
 static u32 cesar_sndbuf_expand(struct sock *sk)
@@ -857,71 +1843,526 @@ static u32 cesar_sndbuf_expand(struct sock *sk)
 	return 3;
 }
 
+/* Spurious loss or RTO: tp->prior_cwnd still holds the cwnd from before
+ * tcp_init_cwnd_reduction()/tcp_enter_loss(), so bring cwnd_est back too.
+ */
 static u32 cesar_undo_cwnd(struct sock *sk)
 {
+	struct tcp_sock *tp = tcp_sk(sk);
 	struct cesar *cesar = inet_csk_ca(sk);
+	u64 prior_cwnd_est = (u64)tp->prior_cwnd * tp->advmss;
 
 	cesar->full_bw_cnt = 0;
-	return tcp_sk(sk)->snd_cwnd;
+	cesar->rto_pending = 0;
+	cesar->cwnd_est = max_t(u64, cesar->cwnd_est,
+				min_t(u64, prior_cwnd_est, U32_MAX));
+	return max(tp->snd_cwnd, tp->prior_cwnd);
 }
 
 static u32 cesar_ssthresh(struct sock *sk)
 {
-	// cesar_save_cwnd(sk);
 	return TCP_INFINITE_SSTHRESH;	
 }
 
+/* An RTO means the radio link faded for longer than the RTO and what
+ * ewma_bw and the bw filter describe is no longer there: halve them and
+ * restart SU accounting instead of resuming at the old rate. Only done
+ * once the loss stands, see cesar_set_state().
+ */
+static void cesar_reseed_after_rto(struct sock *sk)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
+
+	cesar->ewma_bw >>= 1;
+	cesar->previous_bw = cesar->ewma_bw;
+	minmax_reset(&cesar->bw, cesar->rtt_cnt, cesar_max_bw(sk) >> 1);
+	cesar->full_bw_cnt = 0;
+
+	cesar->previous_rtt = cesar->min_rtt_us;
+	cesar->previous_previous_rtt = cesar->min_rtt_us;
+	cesar->previous_clock_diff = 0;
+	cesar_do_reset(sk, NULL);
+	cesar_stat_inc(sk, events[CESAR_STAT_RTO_RESEEDS]);
+}
+
 static void cesar_set_state(struct sock *sk, u8 new_state)
 {
+	struct tcp_sock *tp = tcp_sk(sk);
 	struct cesar *cesar = inet_csk_ca(sk);
+	u32 old_cwnd_est = cesar->cwnd_est;
+
+	/* Loss in STARTUP: the buffer overflowed, so there is nothing left
+	 * to probe for; go and drain it.
+	 */
+	if (new_state >= TCP_CA_Recovery && cesar->mode == CESAR_STARTUP &&
+	    !cesar->full_bw_reached) {
+		cesar->full_bw_reached = 1;
+		cesar_stat_inc(sk, events[CESAR_STAT_STARTUP_EXIT_LOSS]);
+	}
+
+	/* cwnd_est is halved on the RTO itself, and undo_cwnd() restores it
+	 * from tp->prior_cwnd. A spurious RTO must leave the rate alone too,
+	 * so the reseed waits until Loss ends without undo_cwnd(), or until a
+	 * further RTO shows the first one was real.
+	 */
+	if (cesar->rto_pending) {
+		cesar->rto_pending = 0;
+		cesar_reseed_after_rto(sk);
+	}
 
 	if (new_state == TCP_CA_Loss) {
-		struct rate_sample rs = { .losses = 1 };
+		cesar->cwnd_est = max(cesar->cwnd_est >> 1,
+				      cesar_cwnd_min_target * tp->advmss);
+		cesar->rto_pending = 1;
 		cesar->prev_ca_state = TCP_CA_Loss;
+		cesar->round_start = 1;	/* treat RTO like end of a round */
+		trace_cesar_cwnd_adjust(sk, old_cwnd_est, 0);
+	} else if (new_state == TCP_CA_Recovery &&
+		   cesar->prev_ca_state < TCP_CA_Recovery) {
+		cesar->cwnd_est = max_t(u32, (u64)cesar->cwnd_est * cesar_loss_beta >> CESAR_SCALE,
+					cesar_cwnd_min_target * tp->advmss);
+		trace_cesar_cwnd_adjust(sk, old_cwnd_est, 0);
 	}
 }
 
-static void cesar_acked(struct sock *sk, const struct ack_sample *sample)
+#ifndef CESAR_BPF
+static size_t cesar_get_info(struct sock *sk, u32 ext, int *attr,
+			     union tcp_cc_info *info)
 {
+	if (ext & (1 << (INET_DIAG_BBRINFO - 1)) ||
+	    ext & (1 << (INET_DIAG_VEGASINFO - 1))) {
+		struct tcp_cesar_info *ci = (struct tcp_cesar_info *)info;
+		struct cesar *cesar = inet_csk_ca(sk);
+		u64 bw = cesar_rate_bytes_per_sec(sk, cesar->ewma_bw, CESAR_UNIT);
+
+		memset(ci, 0, sizeof(*ci));
+		ci->cesar_ewma_bw	= min_t(u64, bw, U32_MAX);
+		ci->cesar_cwnd_est	= cesar->cwnd_est;
+		ci->cesar_min_rtt	= cesar->min_rtt_us;
+		ci->cesar_su		= cesar->su;
+		ci->cesar_pacing_gain	= cesar->pacing_gain;
+		ci->cesar_mode		= cesar->mode;
+		ci->cesar_pattern_count	= cesar->pattern_count;
+		ci->cesar_su_confidence	= cesar->su_confidence;
+		if (cesar->full_bw_reached)
+			ci->cesar_flags |= CESAR_INFO_FULL_BW_REACHED;
+		if (cesar_param(sk, scheduling_unit))
+			ci->cesar_flags |= CESAR_INFO_SU_FIXED;
+		if (cesar->probe_rtt)
+			ci->cesar_flags |= CESAR_INFO_PROBE_RTT;
+		if (cesar_su_pacing(sk))
+			ci->cesar_flags |= CESAR_INFO_SU_PACING;
+		if (cesar->dst_shared)
+			ci->cesar_flags |= CESAR_INFO_DST_SHARED;
+		ci->cesar_flags |= cesar->profile << CESAR_INFO_PROFILE_SHIFT;
+		*attr = INET_DIAG_CESARINFO;
+		return sizeof(*ci);
+	}
+	return 0;
+}
+#endif
+
+/* Sending again after the application ran dry, e.g. the next chunk of a
+ * video stream: the link did not slow down while we were idle, so resume
+ * at the rate we had, as BBR does, and resync the SU clock on the first
+ * ACK back.
+ */
+static void cesar_cwnd_event(struct sock *sk, enum tcp_ca_event event)
+{
+	struct cesar *cesar = inet_csk_ca(sk);
 	struct tcp_sock *tp = tcp_sk(sk);
 
+	if (event != CA_EVENT_TX_START || !tp->app_limited)
+		return;
+
+	cesar->idle_restart = 1;
+	if (cesar->mode == CESAR_STEADY)
+		cesar_set_pacing_rate(sk, cesar_ewma_bw_alpha(sk, NULL),
+				      CESAR_UNIT, NULL);
+}
+
+static void cesar_acked(struct sock *sk, const struct ack_sample *sample)
+{
 	if(sample->rtt_us <= 0){
 		return;
 	}
 
-	printk(KERN_WARNING "LOG: %d cwnd %u rtt %u mss %u byte_ack %u \n", ntohs((tp->inet_conn).icsk_inet.inet_sport), 
-	tp->snd_cwnd, sample->rtt_us, tp->advmss,tp->bytes_acked);
-	
+	trace_cesar_rtt_sample(sk, sample);
+}
+
+/* Everything below is kernel module glue; bpf/tcp_cesar.bpf.c supplies its
+ * own struct_ops and loader.
+ */
+#ifndef CESAR_BPF
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+/* cong_control takes the ACK's sequence and FLAG_* ahead of rs since 6.10 */
+static void cesar_cong_control(struct sock *sk, u32 ack, int flag,
+			       const struct rate_sample *rs)
+{
+	cesar_main(sk, rs);
+}
+#else
+#define cesar_cong_control cesar_main
+#endif
+
+/* Profile 0; cesar_register() copies it into "cesar1" to "cesar7" */
+static struct tcp_congestion_ops tcp_cesar_cong_ops[CESAR_NR_PROFILES] __read_mostly = {
+	[0] = {
+		.flags		= TCP_CONG_NON_RESTRICTED,
+		.name		= "cesar",
+		.owner		= THIS_MODULE,
+		.init		= cesar_init,
+		.cong_control	= cesar_cong_control,
+		.sndbuf_expand	= cesar_sndbuf_expand,
+		.undo_cwnd	= cesar_undo_cwnd,
+		.ssthresh	= cesar_ssthresh,
+		.min_tso_segs	= cesar_min_tso_segs,
+		.set_state	= cesar_set_state,
+		.cwnd_event	= cesar_cwnd_event,
+		.pkts_acked	= cesar_acked,
+		.get_info	= cesar_get_info,
+		.release	= cesar_release,
+	},
+};
+
+static int cesar_su_max = U16_MAX;
+static int cesar_beta_max = 100;
+static int cesar_bin_us_min = PATTERN_BIN_MIN_US;
+static int cesar_bin_us_max = PATTERN_BIN_MIN_US << PATTERN_BIN_SHIFT_MAX;
+
+/* .data is filled in per netns by cesar_net_init(). No { } sentinel:
+ * the table is registered by size, and 6.11+ refuses an entry without
+ * a procname.
+ */
+static struct ctl_table cesar_sysctl_table[] = {
+	{
+		.procname	= "tcp_cesar_scheduling_unit",
+		.maxlen		= sizeof_field(struct cesar_params, scheduling_unit),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= &cesar_su_max,
+	},
+	{
+		.procname	= "tcp_cesar_alpha",
+		.maxlen		= sizeof_field(struct cesar_params, alpha),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+	},
+	{
+		.procname	= "tcp_cesar_beta",
+		.maxlen		= sizeof_field(struct cesar_params, beta),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= &cesar_beta_max,
+	},
+	{
+		.procname	= "tcp_cesar_gamma",
+		.maxlen		= sizeof_field(struct cesar_params, gamma),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ONE,
+	},
+	{
+		.procname	= "tcp_cesar_pattern_bin_us",
+		.maxlen		= sizeof_field(struct cesar_params, pattern_bin_us),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &cesar_bin_us_min,
+		.extra2		= &cesar_bin_us_max,
+	},
+	{
+		.procname	= "tcp_cesar_su_pacing",
+		.maxlen		= sizeof_field(struct cesar_params, su_pacing),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
+	{
+		.procname	= "tcp_cesar_share",
+		.maxlen		= sizeof_field(struct cesar_params, share),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
+};
+
+static const char * const cesar_stat_names[CESAR_STAT_MAX] = {
+	[CESAR_STAT_FLOWS]		= "flows",
+	[CESAR_STAT_SU_DECISIONS]	= "su_decisions",
+	[CESAR_STAT_SU_LOCKS]		= "su_locks",
+	[CESAR_STAT_SU_SWITCHES]	= "su_switches",
+	[CESAR_STAT_SU_FALLBACKS]	= "su_fallbacks",
+	[CESAR_STAT_STARTUP_EXIT_BW]	= "startup_exit_bw",
+	[CESAR_STAT_STARTUP_EXIT_RTT]	= "startup_exit_rtt",
+	[CESAR_STAT_STARTUP_EXIT_LOSS]	= "startup_exit_loss",
+	[CESAR_STAT_DRAIN_TIMEOUTS]	= "drain_timeouts",
+	[CESAR_STAT_RTO_RESEEDS]	= "rto_reseeds",
+	[CESAR_STAT_ECN_CUTS]		= "ecn_cuts",
+	[CESAR_STAT_DST_SEEDS]		= "dst_seeds",
+};
+
+static const char * const cesar_mode_names[CESAR_NR_MODES] = {
+	[CESAR_STARTUP]	= "startup",
+	[CESAR_DRAIN]	= "drain",
+	[CESAR_STEADY]	= "steady",
+	[CESAR_BBR]	= "bbr",
+};
+
+/* /proc/net/tcp_cesar_stat: one "name value..." line per counter */
+static int cesar_stat_show(struct seq_file *seq, void *v)
+{
+	const struct cesar_net *cn = net_generic(seq_file_single_net(seq), cesar_net_id);
+	struct cesar_stats sum = {};
+	u64 *dst = (u64 *)&sum;
+	int cpu, from, to;
+	size_t i;
+
+	for_each_possible_cpu(cpu) {
+		const u64 *src = (const u64 *)per_cpu_ptr(cn->stats, cpu);
+
+		for (i = 0; i < sizeof(sum) / sizeof(u64); i++)
+			dst[i] += READ_ONCE(src[i]);
+	}
+
+	for (i = 0; i < CESAR_STAT_MAX; i++)
+		seq_printf(seq, "%s %llu\n", cesar_stat_names[i], sum.events[i]);
+
+	/* Flows in each mode now: those that entered it less those that left */
+	for (to = 0; to < CESAR_NR_MODES; to++) {
+		s64 live = to == CESAR_STARTUP ? sum.events[CESAR_STAT_FLOWS] : 0;
+
+		for (from = 0; from < CESAR_NR_MODES; from++)
+			live += sum.mode_change[from][to] - sum.mode_change[to][from];
+		live -= sum.released[to];
+		seq_printf(seq, "flows_%s %lld\n", cesar_mode_names[to], live);
+	}
+
+	for (from = 0; from < CESAR_NR_MODES; from++)
+		for (to = 0; to < CESAR_NR_MODES; to++)
+			if (from != to)
+				seq_printf(seq, "mode_change %s %s %llu\n",
+					   cesar_mode_names[from],
+					   cesar_mode_names[to],
+					   sum.mode_change[from][to]);
+
+	for (i = 0; i < CESAR_SU_HIST_BUCKETS; i++) {
+		if (!sum.su_hist[i])
+			continue;
+		if (i == CESAR_SU_HIST_BUCKETS - 1)
+			seq_printf(seq, "su_us %zu- %llu\n", i * LINE_MARGIN,
+				   sum.su_hist[i]);
+		else
+			seq_printf(seq, "su_us %zu-%zu %llu\n", i * LINE_MARGIN,
+				   (i + 1) * LINE_MARGIN - 1, sum.su_hist[i]);
+	}
+	return 0;
 }
 
-static struct tcp_congestion_ops tcp_cesar_cong_ops __read_mostly = {
-	.flags		= TCP_CONG_NON_RESTRICTED,
-	.name		= "cesar",
-	.owner		= THIS_MODULE,
-	.init		= cesar_init,
-	.cong_control	= cesar_main,
-	.sndbuf_expand	= cesar_sndbuf_expand,
-	.undo_cwnd	= cesar_undo_cwnd,
-	.ssthresh	= cesar_ssthresh,
-	.min_tso_segs	= cesar_min_tso_segs,
-	.set_state	= cesar_set_state,
-	.pkts_acked = cesar_acked,
-	.release = cesar_release,
+static int __net_init cesar_net_init(struct net *net)
+{
+	struct cesar_net *cn = net_generic(net, cesar_net_id);
+	struct ctl_table *table;
+
+	if (net_eq(net, &init_net)) {
+		cn->params = &cesar_init_params;
+	} else {
+		cn->own_params = cesar_init_params;
+		cn->params = &cn->own_params;
+	}
+	hash_init(cn->dst_hash);
+	spin_lock_init(&cn->dst_lock);
+	cn->dst_count = 0;
+
+	cn->stats = alloc_percpu(struct cesar_stats);
+	if (!cn->stats)
+		return -ENOMEM;
+
+	table = kmemdup(cesar_sysctl_table, sizeof(cesar_sysctl_table), GFP_KERNEL);
+	if (!table)
+		goto err_stats;
+	table[0].data = cn->params->scheduling_unit;
+	table[1].data = cn->params->alpha;
+	table[2].data = cn->params->beta;
+	table[3].data = cn->params->gamma;
+	table[4].data = cn->params->pattern_bin_us;
+	table[5].data = cn->params->su_pacing;
+	table[6].data = cn->params->share;
+
+	cn->sysctl_hdr = register_net_sysctl_sz(net, "net/ipv4", table,
+						ARRAY_SIZE(cesar_sysctl_table));
+	if (!cn->sysctl_hdr)
+		goto err_table;
+
+	if (!proc_create_net_single("tcp_cesar_stat", 0444, net->proc_net,
+				    cesar_stat_show, NULL))
+		goto err_sysctl;
+	return 0;
+
+err_sysctl:
+	unregister_net_sysctl_table(cn->sysctl_hdr);
+err_table:
+	kfree(table);
+err_stats:
+	free_percpu(cn->stats);
+	return -ENOMEM;
+}
+
+static void __net_exit cesar_net_exit(struct net *net)
+{
+	struct cesar_net *cn = net_generic(net, cesar_net_id);
+	struct ctl_table *table = cn->sysctl_hdr->ctl_table_arg;
+
+	remove_proc_entry("tcp_cesar_stat", net->proc_net);
+	unregister_net_sysctl_table(cn->sysctl_hdr);
+	kfree(table);
+	free_percpu(cn->stats);
+	cesar_dst_flush(cn);
+}
+
+/* No-overwrite: a full sub-buffer ring refuses the record, which
+ * relay_write() then drops. Called once per refused record.
+ */
+static int cesar_capture_subbuf_start(struct rchan_buf *buf, void *subbuf,
+				      void *prev_subbuf, size_t prev_padding)
+{
+	if (!relay_buf_full(buf))
+		return 1;
+	this_cpu_inc(cesar_capture_lost);
+	return 0;
+}
+
+static struct dentry *cesar_capture_create(const char *filename,
+					   struct dentry *parent, umode_t mode,
+					   struct rchan_buf *buf, int *is_global)
+{
+	return debugfs_create_file(filename, mode, parent, buf,
+				   &relay_file_operations);
+}
+
+static int cesar_capture_remove(struct dentry *dentry)
+{
+	debugfs_remove(dentry);
+	return 0;
+}
+
+static const struct rchan_callbacks cesar_capture_cb = {
+	.subbuf_start		= cesar_capture_subbuf_start,
+	.create_buf_file	= cesar_capture_create,
+	.remove_buf_file	= cesar_capture_remove,
+};
+
+/* tcp_cesar/lost: samples dropped so far, summed over CPUs */
+static int cesar_capture_lost_show(struct seq_file *seq, void *v)
+{
+	u64 lost = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		lost += READ_ONCE(per_cpu(cesar_capture_lost, cpu));
+	seq_printf(seq, "%llu\n", lost);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(cesar_capture_lost);
+
+/* tcp_cesar/sample0, sample1, ...: one relay file per CPU */
+static int __init cesar_capture_init(void)
+{
+	size_t n_subbufs;
+
+	if (!cesar_capture_kb)
+		return 0;
+	n_subbufs = max_t(size_t, 2, DIV_ROUND_UP((size_t)cesar_capture_kb << 10,
+						  CESAR_CAPTURE_SUBBUF));
+
+	cesar_capture_dir = debugfs_create_dir("tcp_cesar", NULL);
+	debugfs_create_file("lost", 0444, cesar_capture_dir, NULL,
+			    &cesar_capture_lost_fops);
+	cesar_capture_chan = relay_open("sample", cesar_capture_dir,
+					CESAR_CAPTURE_SUBBUF, n_subbufs,
+					&cesar_capture_cb, NULL);
+	if (!cesar_capture_chan) {
+		debugfs_remove(cesar_capture_dir);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void cesar_capture_exit(void)
+{
+	if (!cesar_capture_chan)
+		return;
+	relay_close(cesar_capture_chan);
+	cesar_capture_chan = NULL;
+	debugfs_remove(cesar_capture_dir);
+}
+
+static struct pernet_operations cesar_net_ops = {
+	.init	= cesar_net_init,
+	.exit	= cesar_net_exit,
+	.id	= &cesar_net_id,
+	.size	= sizeof(struct cesar_net),
 };
 
 static int __init cesar_register(void)
 {
+	int ret, i;
+
 	BUILD_BUG_ON(sizeof(struct cesar) > ICSK_CA_PRIV_SIZE);
-	return tcp_register_congestion_control(&tcp_cesar_cong_ops);
+	BUILD_BUG_ON(sizeof_field(struct cesar, rtt_pattern) * BITS_PER_BYTE <
+		     MAX_PATTERN_COUNT * PATTERN_BIN_BITS);
+	BUILD_BUG_ON(sizeof(struct tcp_cesar_info) > sizeof(union tcp_cc_info));
+	BUILD_BUG_ON(sizeof(struct cesar_sample) != 56);
+	BUILD_BUG_ON(CESAR_NR_PROFILES > 1 << 3);	/* cesar->profile */
+	BUILD_BUG_ON(PATTERN_BIN_SHIFT_MAX >= 1 << 3);	/* cesar->pattern_bin_shift */
+	BUILD_BUG_ON(PATTERN_DECISION_PERIOD >= 1 << 7);	/* cesar->pattern_count */
+
+	if (cesar_ecn)
+		tcp_cesar_cong_ops[0].flags |= TCP_CONG_NEEDS_ECN;
+	for (i = 1; i < CESAR_NR_PROFILES; i++) {
+		tcp_cesar_cong_ops[i] = tcp_cesar_cong_ops[0];
+		snprintf(tcp_cesar_cong_ops[i].name, TCP_CA_NAME_MAX, "cesar%d", i);
+	}
+
+	ret = cesar_capture_init();
+	if (ret)
+		return ret;
+	ret = register_pernet_subsys(&cesar_net_ops);
+	if (ret)
+		goto err_capture;
+	for (i = 0; i < CESAR_NR_PROFILES; i++) {
+		ret = tcp_register_congestion_control(&tcp_cesar_cong_ops[i]);
+		if (ret)
+			goto err_ops;
+	}
+	return 0;
+
+err_ops:
+	while (i--)
+		tcp_unregister_congestion_control(&tcp_cesar_cong_ops[i]);
+	unregister_pernet_subsys(&cesar_net_ops);
+err_capture:
+	cesar_capture_exit();
+	return ret;
 }
 
 static void __exit cesar_unregister(void)
 {
-	tcp_unregister_congestion_control(&tcp_cesar_cong_ops);
+	int i;
+
+	for (i = 0; i < CESAR_NR_PROFILES; i++)
+		tcp_unregister_congestion_control(&tcp_cesar_cong_ops[i]);
+	unregister_pernet_subsys(&cesar_net_ops);
+	cesar_capture_exit();
 }
 
 module_init(cesar_register);
 module_exit(cesar_unregister);
+#endif /* !CESAR_BPF */
 
 MODULE_AUTHOR("Juhun Shin <jhshin@netlab.snu.ac.kr>");
 MODULE_AUTHOR("Goodsol Lee <gslee2@netlab.snu.ac.kr>");
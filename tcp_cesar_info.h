@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/*
+ * Per-flow state tcp_cesar exports through inet_diag (ss -ti, sock_diag
+ * dumps) and the TCP_CC_INFO socket option, and the per-ACK records of its
+ * sample capture. Shared by the module and the userspace decoders in
+ * tools/cesar_ss.c and tools/cesar_capture.c.
+ */
+#ifndef _TCP_CESAR_INFO_H
+#define _TCP_CESAR_INFO_H
+
+#include <linux/types.h>
+
+/* inet_diag attribute carrying struct tcp_cesar_info. Mainline assigns
+ * attribute types sequentially from 1, so this stays clear of them.
+ */
+#define INET_DIAG_CESARINFO	0x1000
+
+enum cesar_mode {
+	CESAR_STARTUP,
+	CESAR_DRAIN,
+	CESAR_STEADY,
+	CESAR_BBR,
+};
+
+#define CESAR_INFO_FULL_BW_REACHED	0x1	/* left STARTUP */
+#define CESAR_INFO_SU_FIXED		0x2	/* su from cesar_scheduling_unit[profile] */
+#define CESAR_INFO_PROBE_RTT		0x4	/* refreshing min_rtt */
+#define CESAR_INFO_SU_PACING		0x8	/* SU-aligned bursts, cesar_su_pacing */
+#define CESAR_INFO_DST_SHARED		0x10	/* in a cesar_share destination entry */
+#define CESAR_INFO_PROFILE_SHIFT	5	/* bits 5-7: parameter profile */
+#define CESAR_INFO_PROFILE(flags)	((flags) >> CESAR_INFO_PROFILE_SHIFT)
+
+/* Must fit in union tcp_cc_info, i.e. 20 bytes. */
+struct tcp_cesar_info {
+	__u32	cesar_ewma_bw;		/* ewma_bw in bytes/sec, saturated */
+	__u32	cesar_cwnd_est;		/* cwnd_est in bytes */
+	__u32	cesar_min_rtt;		/* min_rtt_us */
+	__u16	cesar_su;		/* scheduling unit in us */
+	__u16	cesar_pacing_gain;	/* pacing_gain << 8 */
+	__u8	cesar_mode;		/* enum cesar_mode */
+	__u8	cesar_flags;		/* CESAR_INFO_* */
+	__u8	cesar_pattern_count;	/* samples towards the next SU decision */
+	__u8	cesar_su_confidence;	/* periodic share of the histogram, /16 */
+};
+
+#define CESAR_SAMPLE_APP_LIMITED	0x1	/* rs->is_app_limited */
+#define CESAR_SAMPLE_LOSS		0x2	/* rs->losses > 0 */
+
+/* One cong_control() call of a captured flow, see cesar_capture(): what
+ * the rate sample fed in and what Cesar set from it. Written to the
+ * capture files in host byte order, 56 bytes each.
+ */
+struct cesar_sample {
+	__u64	time_us;		/* tcp_mstamp of the ACK */
+	__u64	pacing_rate;		/* sk_pacing_rate set, bytes/sec */
+	__u16	sport;
+	__u16	dport;
+	__u16	su;			/* scheduling unit in us */
+	__u8	mode;			/* enum cesar_mode */
+	__u8	flags;			/* CESAR_SAMPLE_* */
+	__s32	rtt_us;			/* rate sample in */
+	__s32	interval_us;
+	__s32	delivered;
+	__u32	acked_sacked;
+	__u32	cwnd_est;		/* model and cwnd out */
+	__u32	snd_cwnd;
+	__u32	min_rtt_us;
+	__u32	ewma_bw;		/* packets/us << 24, as in the module */
+};
+
+#endif /* _TCP_CESAR_INFO_H */
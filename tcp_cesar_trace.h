@@ -0,0 +1,294 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/*
+ * Tracepoints for tcp_cesar. Only included from tcp_cesar.c, after
+ * struct cesar is defined, so the events can read the per-flow state
+ * directly instead of taking it all as arguments.
+ *
+ * Every event is off by default, e.g.
+ *   echo 1 > /sys/kernel/tracing/events/tcp_cesar/cesar_ack/enable
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tcp_cesar
+
+#if !defined(_TCP_CESAR_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TCP_CESAR_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <net/inet_sock.h>
+#include <net/tcp.h>
+
+TRACE_DEFINE_ENUM(CESAR_STARTUP);
+TRACE_DEFINE_ENUM(CESAR_DRAIN);
+TRACE_DEFINE_ENUM(CESAR_STEADY);
+TRACE_DEFINE_ENUM(CESAR_BBR);
+
+#define show_cesar_mode(mode)				\
+	__print_symbolic(mode,				\
+		{ CESAR_STARTUP,	"STARTUP" },	\
+		{ CESAR_DRAIN,		"DRAIN" },	\
+		{ CESAR_STEADY,		"STEADY" },	\
+		{ CESAR_BBR,		"BBR" })
+
+DECLARE_EVENT_CLASS(cesar_sock,
+
+	TP_PROTO(const struct sock *sk),
+
+	TP_ARGS(sk),
+
+	TP_STRUCT__entry(
+		__field(const void *, skaddr)
+		__field(__u16, sport)
+		__field(__u16, dport)
+	),
+
+	TP_fast_assign(
+		__entry->skaddr = sk;
+		__entry->sport = ntohs(inet_sk(sk)->inet_sport);
+		__entry->dport = ntohs(inet_sk(sk)->inet_dport);
+	),
+
+	TP_printk("sport=%hu dport=%hu skaddr=%p",
+		  __entry->sport, __entry->dport, __entry->skaddr)
+);
+
+DEFINE_EVENT(cesar_sock, cesar_init,
+
+	TP_PROTO(const struct sock *sk),
+
+	TP_ARGS(sk)
+);
+
+DEFINE_EVENT(cesar_sock, cesar_release,
+
+	TP_PROTO(const struct sock *sk),
+
+	TP_ARGS(sk)
+);
+
+/* pkts_acked() RTT sample, the old "LOG:" line. */
+TRACE_EVENT(cesar_rtt_sample,
+
+	TP_PROTO(const struct sock *sk, const struct ack_sample *sample),
+
+	TP_ARGS(sk, sample),
+
+	TP_STRUCT__entry(
+		__field(__u16, sport)
+		__field(__u32, snd_cwnd)
+		__field(__s32, rtt_us)
+		__field(__u16, advmss)
+		__field(__u64, bytes_acked)
+	),
+
+	TP_fast_assign(
+		const struct tcp_sock *tp = tcp_sk(sk);
+
+		__entry->sport = ntohs(inet_sk(sk)->inet_sport);
+		__entry->snd_cwnd = tp->snd_cwnd;
+		__entry->rtt_us = sample->rtt_us;
+		__entry->advmss = tp->advmss;
+		__entry->bytes_acked = tp->bytes_acked;
+	),
+
+	TP_printk("sport=%hu cwnd=%u rtt=%d mss=%hu bytes_acked=%llu",
+		  __entry->sport, __entry->snd_cwnd, __entry->rtt_us,
+		  __entry->advmss, __entry->bytes_acked)
+);
+
+/* cong_control() input and model state, the old "DEBUG:" line. */
+TRACE_EVENT(cesar_ack,
+
+	TP_PROTO(const struct sock *sk, const struct rate_sample *rs),
+
+	TP_ARGS(sk, rs),
+
+	TP_STRUCT__entry(
+		__field(__u16, sport)
+		__field(__u8, mode)
+		__field(__u8, app_limited)
+		__field(__u16, su)
+		__field(__u16, pacing_gain)
+		__field(__u32, cwnd_est)
+		__field(__s32, rtt_us)
+		__field(__u32, min_rtt_us)
+		__field(__u32, previous_rtt)
+		__field(__u32, ewma_bw)
+		__field(__u32, max_bw)
+		__field(__s32, interval_us)
+		__field(__s32, delivered)
+		__field(__u32, acked_sacked)
+		__field(__u32, clock_diff)
+		__field(__u32, snd_cwnd)
+		__field(__u64, pacing_rate)
+	),
+
+	TP_fast_assign(
+		const struct tcp_sock *tp = tcp_sk(sk);
+		const struct cesar *cesar = inet_csk_ca(sk);
+
+		__entry->sport = ntohs(inet_sk(sk)->inet_sport);
+		__entry->mode = cesar->mode;
+		__entry->app_limited = rs->is_app_limited;
+		__entry->su = cesar->su;
+		__entry->pacing_gain = cesar->pacing_gain;
+		__entry->cwnd_est = cesar->cwnd_est;
+		__entry->rtt_us = rs->rtt_us;
+		__entry->min_rtt_us = cesar->min_rtt_us;
+		__entry->previous_rtt = cesar->previous_rtt;
+		__entry->ewma_bw = cesar->ewma_bw;
+		__entry->max_bw = minmax_get(&cesar->bw);
+		__entry->interval_us = rs->interval_us;
+		__entry->delivered = rs->delivered;
+		__entry->acked_sacked = rs->acked_sacked;
+		__entry->clock_diff = tp->tcp_mstamp - cesar->previous_clock;
+		__entry->snd_cwnd = tp->snd_cwnd;
+		__entry->pacing_rate = sk->sk_pacing_rate;
+	),
+
+	TP_printk("sport=%hu mode=%s su=%hu cwnd_est=%u rtt=%d min_rtt=%u previous_rtt=%u ewma_bw=%u max_bw=%u interval=%d delivered=%d acked=%u clock_diff=%u cwnd=%u pacing_rate=%llu pacing_gain=%hu app_limited=%u",
+		  __entry->sport, show_cesar_mode(__entry->mode), __entry->su,
+		  __entry->cwnd_est, __entry->rtt_us, __entry->min_rtt_us,
+		  __entry->previous_rtt, __entry->ewma_bw, __entry->max_bw,
+		  __entry->interval_us, __entry->delivered,
+		  __entry->acked_sacked, __entry->clock_diff,
+		  __entry->snd_cwnd, __entry->pacing_rate,
+		  __entry->pacing_gain, __entry->app_limited)
+);
+
+TRACE_EVENT(cesar_mode_change,
+
+	TP_PROTO(const struct sock *sk, u8 old_mode, u8 new_mode),
+
+	TP_ARGS(sk, old_mode, new_mode),
+
+	TP_STRUCT__entry(
+		__field(__u16, sport)
+		__field(__u8, old_mode)
+		__field(__u8, new_mode)
+	),
+
+	TP_fast_assign(
+		__entry->sport = ntohs(inet_sk(sk)->inet_sport);
+		__entry->old_mode = old_mode;
+		__entry->new_mode = new_mode;
+	),
+
+	TP_printk("sport=%hu %s -> %s", __entry->sport,
+		  show_cesar_mode(__entry->old_mode),
+		  show_cesar_mode(__entry->new_mode))
+);
+
+TRACE_EVENT(cesar_probe_rtt,
+
+	TP_PROTO(const struct sock *sk, bool enter),
+
+	TP_ARGS(sk, enter),
+
+	TP_STRUCT__entry(
+		__field(__u16, sport)
+		__field(bool, enter)
+		__field(__u32, min_rtt_us)
+		__field(__u32, snd_cwnd)
+	),
+
+	TP_fast_assign(
+		const struct cesar *cesar = inet_csk_ca(sk);
+
+		__entry->sport = ntohs(inet_sk(sk)->inet_sport);
+		__entry->enter = enter;
+		__entry->min_rtt_us = cesar->min_rtt_us;
+		__entry->snd_cwnd = tcp_sk(sk)->snd_cwnd;
+	),
+
+	TP_printk("sport=%hu %s min_rtt=%u cwnd=%u", __entry->sport,
+		  __entry->enter ? "enter" : "exit", __entry->min_rtt_us,
+		  __entry->snd_cwnd)
+);
+
+/* Outcome of cesar_pattern_decision() with the three strongest bins. */
+TRACE_EVENT(cesar_su_decision,
+
+	TP_PROTO(const struct sock *sk, const u8 *index, const u16 *value,
+		 u32 bin_us),
+
+	TP_ARGS(sk, index, value, bin_us),
+
+	TP_STRUCT__entry(
+		__field(__u16, sport)
+		__field(__u16, su)
+		__field(__u8, mode)
+		__field(__u8, confidence)
+		__field(__u16, bin_us)
+		__array(__u8, index, 3)
+		__array(__u16, value, 3)
+	),
+
+	TP_fast_assign(
+		const struct cesar *cesar = inet_csk_ca(sk);
+
+		__entry->sport = ntohs(inet_sk(sk)->inet_sport);
+		__entry->su = cesar->su;
+		__entry->mode = cesar->mode;
+		__entry->confidence = cesar->su_confidence;
+		__entry->bin_us = bin_us;
+		memcpy(__entry->index, index, sizeof(__entry->index));
+		memcpy(__entry->value, value, sizeof(__entry->value));
+	),
+
+	TP_printk("sport=%hu su=%hu mode=%s confidence=%u/16 bin_us=%hu bins=%u:%u,%u:%u,%u:%u",
+		  __entry->sport, __entry->su, show_cesar_mode(__entry->mode),
+		  __entry->confidence, __entry->bin_us,
+		  __entry->index[0], __entry->value[0],
+		  __entry->index[1], __entry->value[1],
+		  __entry->index[2], __entry->value[2])
+);
+
+/* cwnd_est update at a scheduling unit boundary. */
+TRACE_EVENT(cesar_cwnd_adjust,
+
+	TP_PROTO(const struct sock *sk, u32 old_cwnd_est, u32 su_bw),
+
+	TP_ARGS(sk, old_cwnd_est, su_bw),
+
+	TP_STRUCT__entry(
+		__field(__u16, sport)
+		__field(__u32, old_cwnd_est)
+		__field(__u32, cwnd_est)
+		__field(__u32, previous_rtt)
+		__field(__u32, previous_previous_rtt)
+		__field(__u32, min_rtt_us)
+		__field(__u32, ewma_bw)
+		__field(__u32, previous_bw)
+		__field(__u32, su_bw)
+		__field(__u16, pacing_gain)
+	),
+
+	TP_fast_assign(
+		const struct cesar *cesar = inet_csk_ca(sk);
+
+		__entry->sport = ntohs(inet_sk(sk)->inet_sport);
+		__entry->old_cwnd_est = old_cwnd_est;
+		__entry->cwnd_est = cesar->cwnd_est;
+		__entry->previous_rtt = cesar->previous_rtt;
+		__entry->previous_previous_rtt = cesar->previous_previous_rtt;
+		__entry->min_rtt_us = cesar->min_rtt_us;
+		__entry->ewma_bw = cesar->ewma_bw;
+		__entry->previous_bw = cesar->previous_bw;
+		__entry->su_bw = su_bw;
+		__entry->pacing_gain = cesar->pacing_gain;
+	),
+
+	TP_printk("sport=%hu cwnd_est=%u->%u rtt=%u prev_rtt=%u min_rtt=%u ewma_bw=%u previous_bw=%u su_bw=%u pacing_gain=%hu",
+		  __entry->sport, __entry->old_cwnd_est, __entry->cwnd_est,
+		  __entry->previous_rtt, __entry->previous_previous_rtt,
+		  __entry->min_rtt_us, __entry->ewma_bw, __entry->previous_bw,
+		  __entry->su_bw, __entry->pacing_gain)
+);
+
+#endif /* _TCP_CESAR_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE tcp_cesar_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * Drain tcp_cesar's per-ACK sample capture to disk, and print what it saved.
+ *
+ * The module writes one struct cesar_sample per cong_control() call of
+ * every flow cesar_capture_port or cesar_capture_cookie selects, into a
+ * per-CPU relay buffer it creates when loaded with cesar_capture_kb set:
+ *
+ *   modprobe tcp_cesar cesar_capture_kb=16384
+ *   echo 5201 > /sys/module/tcp_cesar/parameters/cesar_capture_port
+ *   cesar_capture -o samples.bin -t 60
+ *
+ * Every debugfs tcp_cesar/sampleN file is read in whole records and
+ * appended to the output as it stands, with no decoding on the way. Each
+ * CPU's records stay in order, but CPUs interleave, so sort by time_us
+ * to follow one flow. Records a full buffer dropped are counted by the
+ * module in tcp_cesar/lost; the run reports how many it lost on stderr
+ * and exits 1 if any were, so a scripted capture cannot miss it.
+ *
+ * -p prints a saved file, or the output of cesar_replay -B, as CSV.
+ *
+ * Usage: cesar_capture [-d dir] [-o file] [-t seconds]
+ *        cesar_capture -p file
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../tcp_cesar_info.h"
+
+#define MAX_CPUS	4096
+/* a whole number of records, so reads never split one */
+#define READ_RECORDS	(1 << 14)
+#define POLL_MS		100
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static int read_lost(const char *dir, unsigned long long *lost)
+{
+	char path[4096];
+	FILE *f;
+	int ok;
+
+	snprintf(path, sizeof(path), "%s/lost", dir);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	ok = fscanf(f, "%llu", lost) == 1;
+	fclose(f);
+	return ok ? 0 : -EINVAL;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = write(fd, buf, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf = (const char *)buf + n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Everything a relay file has now; 0 once it is empty */
+static ssize_t drain(int in, int out, struct cesar_sample *buf,
+		     unsigned long long *records)
+{
+	ssize_t n, total = 0;
+	int err;
+
+	while ((n = read(in, buf, READ_RECORDS * sizeof(*buf))) > 0) {
+		if (n % sizeof(*buf)) {
+			fprintf(stderr, "short record from relay\n");
+			return -EIO;
+		}
+		err = write_full(out, buf, n);
+		if (err)
+			return err;
+		*records += n / sizeof(*buf);
+		total += n;
+	}
+	if (n < 0 && errno != EAGAIN && errno != EINTR)
+		return -errno;
+	return total;
+}
+
+static int capture(const char *dir, const char *path, unsigned int seconds)
+{
+	static struct pollfd fds[MAX_CPUS];
+	unsigned long long records = 0, lost_start, lost_end;
+	struct cesar_sample *buf;
+	time_t deadline = seconds ? time(NULL) + seconds : 0;
+	int out, nfds = 0, i, err;
+	bool more;
+
+	if (read_lost(dir, &lost_start)) {
+		fprintf(stderr, "%s/lost: not there; load tcp_cesar with cesar_capture_kb\n",
+			dir);
+		return 1;
+	}
+	for (nfds = 0; nfds < MAX_CPUS; nfds++) {
+		char file[4096];
+
+		snprintf(file, sizeof(file), "%s/sample%d", dir, nfds);
+		fds[nfds].fd = open(file, O_RDONLY | O_NONBLOCK);
+		if (fds[nfds].fd < 0)
+			break;
+		fds[nfds].events = POLLIN;
+	}
+	if (!nfds) {
+		fprintf(stderr, "%s/sample0: %s\n", dir, strerror(errno));
+		return 1;
+	}
+
+	out = strcmp(path, "-") ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)
+				: STDOUT_FILENO;
+	buf = malloc(READ_RECORDS * sizeof(*buf));
+	if (out < 0 || !buf) {
+		perror(path);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	/* relay only wakes pollers for whole sub-buffers, so read every
+	 * file on a timer as well: a slow flow still shows up promptly.
+	 */
+	err = 0;
+	while (!stop && !err && (!deadline || time(NULL) < deadline)) {
+		poll(fds, nfds, POLL_MS);
+		for (i = 0; i < nfds && !err; i++) {
+			ssize_t n = drain(fds[i].fd, out, buf, &records);
+
+			if (n < 0)
+				err = n;
+		}
+	}
+	/* what was written before we stopped */
+	do {
+		more = false;
+		for (i = 0; i < nfds && !err; i++) {
+			ssize_t n = drain(fds[i].fd, out, buf, &records);
+
+			if (n < 0)
+				err = n;
+			more |= n > 0;
+		}
+	} while (more && !err);
+
+	if (err)
+		fprintf(stderr, "capture: %s\n", strerror(-err));
+	if (read_lost(dir, &lost_end))
+		lost_end = lost_start;
+	fprintf(stderr, "%llu samples from %d CPUs, %llu lost\n", records, nfds,
+		lost_end - lost_start);
+
+	for (i = 0; i < nfds; i++)
+		close(fds[i].fd);
+	if (out != STDOUT_FILENO && close(out)) {
+		perror(path);
+		err = -errno;
+	}
+	free(buf);
+	return err || lost_end != lost_start;
+}
+
+static int print(const char *path)
+{
+	struct cesar_sample s;
+	FILE *in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+
+	if (!in) {
+		perror(path);
+		return 1;
+	}
+	printf("time_us,sport,dport,rtt_us,interval_us,delivered,acked_sacked,app_limited,loss,"
+	       "mode,su,cwnd_est,snd_cwnd,pacing_rate,min_rtt_us,ewma_bw\n");
+	while (fread(&s, sizeof(s), 1, in) == 1)
+		printf("%llu,%u,%u,%d,%d,%d,%u,%u,%u,%u,%u,%u,%u,%llu,%u,%u\n",
+		       (unsigned long long)s.time_us, s.sport, s.dport,
+		       s.rtt_us, s.interval_us, s.delivered, s.acked_sacked,
+		       !!(s.flags & CESAR_SAMPLE_APP_LIMITED),
+		       !!(s.flags & CESAR_SAMPLE_LOSS), s.mode, s.su,
+		       s.cwnd_est, s.snd_cwnd, (unsigned long long)s.pacing_rate,
+		       s.min_rtt_us, s.ewma_bw);
+	if (ferror(in)) {
+		perror(path);
+		return 1;
+	}
+	if (in != stdin)
+		fclose(in);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d dir] [-o file] [-t seconds]\n"
+		"       %s -p file\n",
+		prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = "/sys/kernel/debug/tcp_cesar", *out = "-";
+	const char *printed = NULL;
+	unsigned int seconds = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:o:t:p:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 'o':
+			out = optarg;
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			printed = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+	if (optind != argc) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if (printed)
+		return print(printed);
+	return capture(dir, out, seconds);
+}
@@ -0,0 +1,775 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * Offline analyzer for Cesar's per-ACK logs. Reads both the "DEBUG:" and
+ * "LOG:" printk lines older builds wrote to dmesg and the cesar_ack and
+ * cesar_rtt_sample tracepoint lines that replaced them (trace_pipe or
+ * trace-cmd report output), demuxes them by source port and prints, per
+ * port, how long it took to lock on an SU, how long it spent in each mode,
+ * how far snd_cwnd strayed from cwnd_est and the RTT percentiles.
+ *
+ * Usage: cesar_log [-j threads] [-o outdir] log ...
+ *
+ * Each file is mmapped and cut at line boundaries into one slice per
+ * thread; slices are parsed in parallel and stitched back in file order,
+ * so rows stay in the order they were logged. -o also writes every ACK of
+ * port P to outdir/P.csv and every RTT sample to outdir/P.rtt.csv, one
+ * column per field, for plotting. Times are microseconds: tcp_mstamp for
+ * DEBUG lines, the trace clock for tracepoints, the dmesg stamp for LOG
+ * lines, 0 when a line carries none. A port reused by a later connection
+ * is reported as one flow.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../tcp_cesar_info.h"
+
+#define NR_PORTS	65536
+#define NR_MODES	(CESAR_BBR + 1)
+#define MAX_FIELDS	24
+
+static const char *const mode_name[] = {
+	[CESAR_STARTUP]	= "STARTUP",
+	[CESAR_DRAIN]	= "DRAIN",
+	[CESAR_STEADY]	= "STEADY",
+	[CESAR_BBR]	= "BBR",
+};
+
+/* One cong_control() call: a DEBUG line or a cesar_ack event */
+struct ack_row {
+	uint64_t time_us;
+	uint64_t pacing_rate;
+	uint32_t cwnd_est;
+	uint32_t snd_cwnd;
+	uint32_t min_rtt_us;
+	uint32_t ewma_bw;
+	uint32_t max_bw;
+	uint32_t acked_sacked;
+	uint32_t clock_diff;
+	int32_t rtt_us;
+	int32_t interval_us;
+	int32_t delivered;
+	uint16_t su;
+	uint16_t pacing_gain;
+	uint16_t mss;		/* DEBUG lines only */
+	uint8_t mode;
+	uint8_t app_limited;
+};
+
+/* One pkts_acked() sample: a LOG line or a cesar_rtt_sample event */
+struct rtt_row {
+	uint64_t time_us;
+	uint64_t bytes_acked;
+	uint32_t snd_cwnd;
+	int32_t rtt_us;
+	uint16_t mss;
+};
+
+struct flow {
+	struct ack_row *acks;
+	size_t nr_acks, cap_acks;
+	struct rtt_row *rtts;
+	size_t nr_rtts, cap_rtts;
+};
+
+struct slice {
+	const char *start;
+	const char *end;
+	struct flow **flows;	/* NR_PORTS, allocated on first use */
+	uint64_t lines;
+	uint64_t skipped;
+	int err;
+};
+
+struct summary {
+	uint64_t acks, rtts;
+	uint64_t lock_us;	/* ~0 if it never reached STEADY */
+	uint64_t dwell_us[NR_MODES];
+	double cwnd_err;	/* < 0 without mss */
+	int32_t rtt_pct[3];	/* p50, p95, p99; -1 without samples */
+};
+
+static const char *outdir;
+
+static void *grow(void *p, size_t *cap, size_t size)
+{
+	size_t n = *cap ? *cap * 2 : 256;
+
+	p = realloc(p, n * size);
+	if (p)
+		*cap = n;
+	return p;
+}
+
+static struct flow *slice_flow(struct slice *s, uint16_t port)
+{
+	if (!s->flows) {
+		s->flows = calloc(NR_PORTS, sizeof(*s->flows));
+		if (!s->flows)
+			return NULL;
+	}
+	if (!s->flows[port])
+		s->flows[port] = calloc(1, sizeof(struct flow));
+	return s->flows[port];
+}
+
+/* Every number in [p, end) in order, skipping the labels between them */
+static int scan_numbers(const char *p, const char *end, int64_t *v, int max)
+{
+	int n = 0;
+
+	while (p < end && n < max) {
+		bool neg = false;
+		uint64_t x = 0;
+
+		if (*p == '-' && p + 1 < end && p[1] >= '0' && p[1] <= '9') {
+			neg = true;
+			p++;
+		} else if (*p < '0' || *p > '9') {
+			p++;
+			continue;
+		}
+		while (p < end && *p >= '0' && *p <= '9')
+			x = x * 10 + (*p++ - '0');
+		v[n++] = neg ? -(int64_t)x : (int64_t)x;
+	}
+	return n;
+}
+
+/* "seconds.micros" ending right before end, as the dmesg and ftrace
+ * prefixes write it; 0 if there is none.
+ */
+static uint64_t scan_stamp(const char *start, const char *end)
+{
+	const char *p = end;
+	uint64_t sec = 0, usec = 0, scale = 1;
+
+	while (p > start && p[-1] >= '0' && p[-1] <= '9') {
+		usec += (p[-1] - '0') * scale;
+		scale *= 10;
+		p--;
+	}
+	if (p == end || p == start || p[-1] != '.')
+		return 0;
+	/* nanosecond trace clocks print 9 digits */
+	while (scale > 1000000) {
+		usec /= 10;
+		scale /= 10;
+	}
+	while (scale < 1000000) {
+		usec *= 10;
+		scale *= 10;
+	}
+	p--;
+	for (scale = 1; p > start && p[-1] >= '0' && p[-1] <= '9'; p--, scale *= 10)
+		sec += (p[-1] - '0') * scale;
+	return sec * 1000000 + usec;
+}
+
+/* "[  123.456789] " in front of a dmesg line */
+static uint64_t dmesg_stamp(const char *line, const char *end)
+{
+	const char *close = memchr(line, ']', end - line);
+
+	return line[0] == '[' && close ? scan_stamp(line, close) : 0;
+}
+
+static int mode_from_name(const char *p, const char *end)
+{
+	int i;
+
+	for (i = 0; i < NR_MODES; i++) {
+		size_t len = strlen(mode_name[i]);
+
+		if ((size_t)(end - p) >= len && !memcmp(p, mode_name[i], len))
+			return i;
+	}
+	return -1;
+}
+
+/* A sport past 16 bits is a garbled line, not a flow to fold into another */
+static int add_ack(struct slice *s, int64_t port, const struct ack_row *row)
+{
+	struct flow *f;
+
+	if (port < 0 || port >= NR_PORTS)
+		return -EINVAL;
+	f = slice_flow(s, port);
+	if (!f)
+		return -ENOMEM;
+	if (f->nr_acks == f->cap_acks) {
+		struct ack_row *a = grow(f->acks, &f->cap_acks, sizeof(*a));
+
+		if (!a)
+			return -ENOMEM;
+		f->acks = a;
+	}
+	f->acks[f->nr_acks++] = *row;
+	return 0;
+}
+
+static int add_rtt(struct slice *s, int64_t port, const struct rtt_row *row)
+{
+	struct flow *f;
+
+	if (port < 0 || port >= NR_PORTS)
+		return -EINVAL;
+	f = slice_flow(s, port);
+	if (!f)
+		return -ENOMEM;
+	if (f->nr_rtts == f->cap_rtts) {
+		struct rtt_row *r = grow(f->rtts, &f->cap_rtts, sizeof(*r));
+
+		if (!r)
+			return -ENOMEM;
+		f->rtts = r;
+	}
+	f->rtts[f->nr_rtts++] = *row;
+	return 0;
+}
+
+/* DEBUG: sport cwnd_est rtt X min X current_clock X previous_rtt X period X
+ * ewma X max X bound_max X inter X deliver X clock X snd X condition X
+ * pacing X beta X g X ack X mss X app X X | mode
+ */
+static int parse_debug(struct slice *s, const char *p, const char *end)
+{
+	struct ack_row row = { 0 };
+	int64_t v[MAX_FIELDS];
+
+	if (scan_numbers(p, end, v, MAX_FIELDS) != 23 || v[22] < 0 ||
+	    v[22] >= NR_MODES)
+		return -EINVAL;
+	row.cwnd_est = v[1];
+	row.rtt_us = v[2];
+	row.min_rtt_us = v[3];
+	row.time_us = (uint32_t)v[4];
+	row.su = v[6];
+	row.ewma_bw = v[7];
+	row.max_bw = v[8];
+	row.interval_us = v[10];
+	row.delivered = v[11];
+	row.clock_diff = v[12];
+	row.snd_cwnd = v[13];
+	row.pacing_rate = v[15];
+	row.pacing_gain = v[17];
+	row.acked_sacked = v[18];
+	row.mss = v[19];
+	row.app_limited = v[20];
+	row.mode = v[22];
+	return add_ack(s, v[0], &row);
+}
+
+/* sport=%hu mode=%s su=%hu cwnd_est=%u rtt=%d min_rtt=%u previous_rtt=%u
+ * ewma_bw=%u max_bw=%u interval=%d delivered=%d acked=%u clock_diff=%u
+ * cwnd=%u pacing_rate=%llu pacing_gain=%hu app_limited=%u
+ */
+static int parse_ack_event(struct slice *s, const char *p, const char *end,
+			   uint64_t time_us)
+{
+	struct ack_row row = { .time_us = time_us };
+	const char *m = memmem(p, end - p, "mode=", 5);
+	int64_t v[MAX_FIELDS];
+	int mode;
+
+	if (!m || (mode = mode_from_name(m + 5, end)) < 0 ||
+	    scan_numbers(p, end, v, MAX_FIELDS) != 16)
+		return -EINVAL;
+	row.mode = mode;
+	row.su = v[1];
+	row.cwnd_est = v[2];
+	row.rtt_us = v[3];
+	row.min_rtt_us = v[4];
+	row.ewma_bw = v[6];
+	row.max_bw = v[7];
+	row.interval_us = v[8];
+	row.delivered = v[9];
+	row.acked_sacked = v[10];
+	row.clock_diff = v[11];
+	row.snd_cwnd = v[12];
+	row.pacing_rate = v[13];
+	row.pacing_gain = v[14];
+	row.app_limited = v[15];
+	return add_ack(s, v[0], &row);
+}
+
+/* LOG: sport cwnd X rtt X mss X byte_ack X, and cesar_rtt_sample's
+ * sport=%hu cwnd=%u rtt=%d mss=%hu bytes_acked=%llu: same fields in the
+ * same order.
+ */
+static int parse_rtt(struct slice *s, const char *p, const char *end,
+		     uint64_t time_us)
+{
+	struct rtt_row row = { .time_us = time_us };
+	int64_t v[MAX_FIELDS];
+
+	if (scan_numbers(p, end, v, MAX_FIELDS) != 5)
+		return -EINVAL;
+	row.snd_cwnd = v[1];
+	row.rtt_us = v[2];
+	row.mss = v[3];
+	row.bytes_acked = v[4];
+	return add_rtt(s, v[0], &row);
+}
+
+/* 0 if the line was one of ours, -EINVAL if not, -ENOMEM */
+static int parse_line(struct slice *s, const char *line, const char *end)
+{
+	const char *c = line;
+
+	/* The tag is the word before the first ": " that is not a stamp */
+	while ((c = memchr(c, ':', end - c)) && c + 1 < end) {
+		const char *tag = c;
+		size_t len;
+
+		if (c[1] != ' ') {
+			c++;
+			continue;
+		}
+		while (tag > line && tag[-1] != ' ' && tag[-1] != ']')
+			tag--;
+		len = c - tag;
+
+		if (len == 5 && !memcmp(tag, "DEBUG", 5))
+			return parse_debug(s, c + 2, end);
+		if (len == 3 && !memcmp(tag, "LOG", 3))
+			return parse_rtt(s, c + 2, end, dmesg_stamp(line, end));
+		if (len == 9 && !memcmp(tag, "cesar_ack", 9))
+			return parse_ack_event(s, c + 2, end, scan_stamp(line, tag - 2));
+		if (len == 16 && !memcmp(tag, "cesar_rtt_sample", 16))
+			return parse_rtt(s, c + 2, end, scan_stamp(line, tag - 2));
+		c++;
+	}
+	return -EINVAL;
+}
+
+static void *parse_slice(void *arg)
+{
+	struct slice *s = arg;
+	const char *p = s->start;
+
+	while (p < s->end) {
+		const char *nl = memchr(p, '\n', s->end - p);
+		const char *end = nl ? nl : s->end;
+		int err;
+
+		s->lines++;
+		err = parse_line(s, p, end);
+		if (err == -ENOMEM) {
+			s->err = err;
+			break;
+		}
+		if (err)
+			s->skipped++;
+		p = end + 1;
+	}
+	return NULL;
+}
+
+static void free_flows(struct flow **flows)
+{
+	int port;
+
+	if (!flows)
+		return;
+	for (port = 0; port < NR_PORTS; port++) {
+		if (!flows[port])
+			continue;
+		free(flows[port]->acks);
+		free(flows[port]->rtts);
+		free(flows[port]);
+	}
+	free(flows);
+}
+
+/* Append the slice's rows of each port to flows[], in slice order. What
+ * has been moved over is cleared from the slice, so free_flows() on it
+ * releases only what is left after an error.
+ */
+static int merge_slice(struct flow **flows, struct slice *s)
+{
+	int port;
+
+	if (!s->flows)
+		return 0;
+	for (port = 0; port < NR_PORTS; port++) {
+		struct flow *src = s->flows[port], *dst;
+
+		if (!src)
+			continue;
+		if (!flows[port]) {
+			flows[port] = src;
+			s->flows[port] = NULL;
+			continue;
+		}
+		dst = flows[port];
+		if (src->nr_acks) {
+			struct ack_row *a = realloc(dst->acks,
+				(dst->nr_acks + src->nr_acks) * sizeof(*a));
+
+			if (!a)
+				return -ENOMEM;
+			memcpy(a + dst->nr_acks, src->acks, src->nr_acks * sizeof(*a));
+			dst->acks = a;
+			dst->nr_acks += src->nr_acks;
+			dst->cap_acks = dst->nr_acks;
+		}
+		if (src->nr_rtts) {
+			struct rtt_row *r = realloc(dst->rtts,
+				(dst->nr_rtts + src->nr_rtts) * sizeof(*r));
+
+			if (!r)
+				return -ENOMEM;
+			memcpy(r + dst->nr_rtts, src->rtts, src->nr_rtts * sizeof(*r));
+			dst->rtts = r;
+			dst->nr_rtts += src->nr_rtts;
+			dst->cap_rtts = dst->nr_rtts;
+		}
+		free(src->acks);
+		free(src->rtts);
+		free(src);
+		s->flows[port] = NULL;
+	}
+	free(s->flows);
+	s->flows = NULL;
+	return 0;
+}
+
+static int parse_file(const char *path, struct flow **flows, int threads,
+		      uint64_t *lines, uint64_t *skipped)
+{
+	struct slice *slices;
+	pthread_t *tids;
+	struct stat st;
+	const char *map;
+	int fd, i, err = 0;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st)) {
+		err = -errno;
+		goto out_fd;
+	}
+	if (!st.st_size)
+		goto out_fd;
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		err = -errno;
+		goto out_fd;
+	}
+	madvise((void *)map, st.st_size, MADV_SEQUENTIAL);
+
+	slices = calloc(threads, sizeof(*slices));
+	tids = calloc(threads, sizeof(*tids));
+	if (!slices || !tids) {
+		err = -ENOMEM;
+		goto out_map;
+	}
+
+	/* Cut at the first newline past each 1/threads mark */
+	for (i = 0; i < threads; i++) {
+		const char *end = map + (uint64_t)st.st_size * (i + 1) / threads;
+		const char *nl;
+
+		slices[i].start = i ? slices[i - 1].end : map;
+		if (end < slices[i].start)
+			end = slices[i].start;
+		nl = i + 1 < threads ? memchr(end, '\n', map + st.st_size - end) : NULL;
+		slices[i].end = nl ? nl + 1 : map + st.st_size;
+	}
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&tids[i], NULL, parse_slice, &slices[i])) {
+			parse_slice(&slices[i]);
+			tids[i] = 0;
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		if (tids[i])
+			pthread_join(tids[i], NULL);
+		*lines += slices[i].lines;
+		*skipped += slices[i].skipped;
+		if (slices[i].err && !err)
+			err = slices[i].err;
+		if (!err)
+			err = merge_slice(flows, &slices[i]);
+		free_flows(slices[i].flows);
+	}
+
+out_map:
+	free(slices);
+	free(tids);
+	munmap((void *)map, st.st_size);
+out_fd:
+	if (fd >= 0)
+		close(fd);
+	return err;
+}
+
+static int cmp_s32(const void *a, const void *b)
+{
+	int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* tcp_mstamp in a DEBUG line is a u32 of microseconds: unwrap it */
+static void unwrap_times(struct flow *f)
+{
+	uint64_t base = 0, prev = 0;
+	size_t i;
+
+	for (i = 0; i < f->nr_acks; i++) {
+		uint64_t t = f->acks[i].time_us;
+
+		if (t > UINT32_MAX)
+			return;		/* a 64-bit clock after all */
+		if (i && t + base < prev && prev - (t + base) > (1ULL << 31))
+			base += 1ULL << 32;
+		prev = f->acks[i].time_us = t + base;
+	}
+}
+
+static void summarize(struct flow *f, struct summary *sum)
+{
+	uint64_t first = 0;
+	double err = 0;
+	size_t i, n = 0, nr_rtt = 0;
+	uint16_t mss = 0;
+	int32_t *rtt;
+
+	memset(sum, 0, sizeof(*sum));
+	sum->acks = f->nr_acks;
+	sum->rtts = f->nr_rtts;
+	sum->lock_us = ~0ULL;
+	sum->cwnd_err = -1;
+	sum->rtt_pct[0] = sum->rtt_pct[1] = sum->rtt_pct[2] = -1;
+
+	unwrap_times(f);
+	for (i = 0; i < f->nr_rtts && !mss; i++)
+		mss = f->rtts[i].mss;
+
+	for (i = 0; i < f->nr_acks; i++) {
+		const struct ack_row *a = &f->acks[i];
+		uint16_t m = a->mss ?: mss;
+
+		if (!i)
+			first = a->time_us;
+		if (sum->lock_us == ~0ULL && a->mode == CESAR_STEADY)
+			sum->lock_us = a->time_us - first;
+		if (i + 1 < f->nr_acks && f->acks[i + 1].time_us > a->time_us)
+			sum->dwell_us[a->mode] += f->acks[i + 1].time_us - a->time_us;
+		if (m && a->snd_cwnd) {
+			double est = (double)a->cwnd_est / m;
+
+			err += (est > a->snd_cwnd ? est - a->snd_cwnd : a->snd_cwnd - est) /
+			       a->snd_cwnd;
+			n++;
+		}
+	}
+	if (n)
+		sum->cwnd_err = err * 100 / n;
+
+	/* pkts_acked() samples if there are any, else the ACKs' own */
+	rtt = malloc(((f->nr_rtts ?: f->nr_acks) + 1) * sizeof(*rtt));
+	if (!rtt)
+		return;
+	if (f->nr_rtts) {
+		for (i = 0; i < f->nr_rtts; i++)
+			if (f->rtts[i].rtt_us > 0)
+				rtt[nr_rtt++] = f->rtts[i].rtt_us;
+	} else {
+		for (i = 0; i < f->nr_acks; i++)
+			if (f->acks[i].rtt_us > 0)
+				rtt[nr_rtt++] = f->acks[i].rtt_us;
+	}
+	if (nr_rtt) {
+		qsort(rtt, nr_rtt, sizeof(*rtt), cmp_s32);
+		sum->rtt_pct[0] = rtt[(nr_rtt - 1) * 50 / 100];
+		sum->rtt_pct[1] = rtt[(nr_rtt - 1) * 95 / 100];
+		sum->rtt_pct[2] = rtt[(nr_rtt - 1) * 99 / 100];
+	}
+	free(rtt);
+}
+
+static int write_csv(const struct flow *f, int port)
+{
+	static const char ack_hdr[] =
+		"time_us,mode,su,cwnd_est,snd_cwnd,rtt_us,min_rtt_us,ewma_bw,max_bw,interval_us,delivered,acked_sacked,clock_diff,pacing_rate,pacing_gain,app_limited\n";
+	char path[4096], buf[1 << 16];
+	FILE *out;
+	size_t i;
+
+	snprintf(path, sizeof(path), "%s/%d.csv", outdir, port);
+	out = fopen(path, "w");
+	if (!out)
+		return -errno;
+	setvbuf(out, buf, _IOFBF, sizeof(buf));
+	fputs(ack_hdr, out);
+	for (i = 0; i < f->nr_acks; i++) {
+		const struct ack_row *a = &f->acks[i];
+
+		fprintf(out, "%llu,%s,%u,%u,%u,%d,%u,%u,%u,%d,%d,%u,%u,%llu,%u,%u\n",
+			(unsigned long long)a->time_us, mode_name[a->mode], a->su,
+			a->cwnd_est, a->snd_cwnd, a->rtt_us, a->min_rtt_us,
+			a->ewma_bw, a->max_bw, a->interval_us, a->delivered,
+			a->acked_sacked, a->clock_diff,
+			(unsigned long long)a->pacing_rate, a->pacing_gain,
+			a->app_limited);
+	}
+	if (fclose(out))
+		return -errno;
+	if (!f->nr_rtts)
+		return 0;
+
+	snprintf(path, sizeof(path), "%s/%d.rtt.csv", outdir, port);
+	out = fopen(path, "w");
+	if (!out)
+		return -errno;
+	setvbuf(out, buf, _IOFBF, sizeof(buf));
+	fputs("time_us,snd_cwnd,rtt_us,mss,bytes_acked\n", out);
+	for (i = 0; i < f->nr_rtts; i++) {
+		const struct rtt_row *r = &f->rtts[i];
+
+		fprintf(out, "%llu,%u,%d,%u,%llu\n", (unsigned long long)r->time_us,
+			r->snd_cwnd, r->rtt_us, r->mss,
+			(unsigned long long)r->bytes_acked);
+	}
+	return fclose(out) ? -errno : 0;
+}
+
+/* Summaries and CSVs per port, ports handed out to threads in turn */
+struct report {
+	struct flow **flows;
+	struct summary *sums;
+	int next;		/* next port to take */
+	int err;
+};
+
+static void *report_ports(void *arg)
+{
+	struct report *r = arg;
+	int port, err;
+
+	while ((port = __atomic_fetch_add(&r->next, 1, __ATOMIC_RELAXED)) < NR_PORTS) {
+		if (!r->flows[port])
+			continue;
+		summarize(r->flows[port], &r->sums[port]);
+		if (outdir && (err = write_csv(r->flows[port], port)))
+			__atomic_store_n(&r->err, err, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+static void print_ms(uint64_t us)
+{
+	printf(" %10.1f", us / 1000.0);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-j threads] [-o outdir] log ...\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct report report = { 0 };
+	uint64_t lines = 0, skipped = 0;
+	pthread_t *tids;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int opt, i, port, err = 0, ret = 1;
+
+	while ((opt = getopt(argc, argv, "j:o:h")) != -1) {
+		switch (opt) {
+		case 'j':
+			threads = strtol(optarg, NULL, 0);
+			break;
+		case 'o':
+			outdir = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+	if (optind == argc || threads < 1) {
+		usage(argv[0]);
+		return 2;
+	}
+	if (outdir && mkdir(outdir, 0755) && errno != EEXIST) {
+		perror(outdir);
+		return 1;
+	}
+
+	report.flows = calloc(NR_PORTS, sizeof(*report.flows));
+	report.sums = calloc(NR_PORTS, sizeof(*report.sums));
+	tids = calloc(threads, sizeof(*tids));
+	if (!report.flows || !report.sums || !tids) {
+		fprintf(stderr, "out of memory\n");
+		goto out;
+	}
+
+	for (i = optind; i < argc; i++) {
+		err = parse_file(argv[i], report.flows, threads, &lines, &skipped);
+		if (err) {
+			fprintf(stderr, "%s: %s\n", argv[i], strerror(-err));
+			goto out;
+		}
+	}
+
+	for (i = 0; i < threads; i++)
+		if (pthread_create(&tids[i], NULL, report_ports, &report))
+			tids[i] = 0;
+	report_ports(&report);
+	for (i = 0; i < threads; i++)
+		if (tids[i])
+			pthread_join(tids[i], NULL);
+	if (report.err) {
+		fprintf(stderr, "%s: %s\n", outdir, strerror(-report.err));
+		goto out;
+	}
+
+	printf("%5s %9s %9s %10s %10s %10s %10s %10s %8s %8s %8s %8s\n",
+	       "sport", "acks", "rtts", "lock_ms", "startup_ms", "drain_ms",
+	       "steady_ms", "bbr_ms", "cwnd_err", "rtt50", "rtt95", "rtt99");
+	for (port = 0; port < NR_PORTS; port++) {
+		const struct summary *s = &report.sums[port];
+
+		if (!report.flows[port])
+			continue;
+		printf("%5d %9llu %9llu", port, (unsigned long long)s->acks,
+		       (unsigned long long)s->rtts);
+		if (s->lock_us == ~0ULL)
+			printf(" %10s", "-");
+		else
+			print_ms(s->lock_us);
+		print_ms(s->dwell_us[CESAR_STARTUP]);
+		print_ms(s->dwell_us[CESAR_DRAIN]);
+		print_ms(s->dwell_us[CESAR_STEADY]);
+		print_ms(s->dwell_us[CESAR_BBR]);
+		if (s->cwnd_err < 0)
+			printf(" %8s", "-");
+		else
+			printf(" %7.1f%%", s->cwnd_err);
+		if (s->rtt_pct[0] < 0)
+			printf(" %8s %8s %8s\n", "-", "-", "-");
+		else
+			printf(" %8d %8d %8d\n", s->rtt_pct[0], s->rtt_pct[1],
+			       s->rtt_pct[2]);
+	}
+	fprintf(stderr, "%llu lines, %llu not from cesar\n",
+		(unsigned long long)lines, (unsigned long long)skipped);
+	ret = 0;
+out:
+	free_flows(report.flows);
+	free(report.sums);
+	free(tids);
+	return ret;
+}
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * Dump the per-flow state of every tcp_cesar socket through sock_diag,
+ * decoding the INET_DIAG_CESARINFO attribute that stock ss skips.
+ *
+ * Usage: cesar_ss [-4 | -6] [-c]
+ *   -c   one CSV row per flow, for monitoring scrapers
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "../tcp_cesar_info.h"
+
+static const char *const mode_name[] = {
+	[CESAR_STARTUP]	= "STARTUP",
+	[CESAR_DRAIN]	= "DRAIN",
+	[CESAR_STEADY]	= "STEADY",
+	[CESAR_BBR]	= "BBR",
+};
+
+static bool csv;
+
+static const char *mode_str(__u8 mode)
+{
+	if (mode < sizeof(mode_name) / sizeof(mode_name[0]) && mode_name[mode])
+		return mode_name[mode];
+	return "?";
+}
+
+static void print_flow(const struct inet_diag_msg *msg,
+		       const struct tcp_cesar_info *ci)
+{
+	char src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+
+	inet_ntop(msg->idiag_family, msg->id.idiag_src, src, sizeof(src));
+	inet_ntop(msg->idiag_family, msg->id.idiag_dst, dst, sizeof(dst));
+
+	if (csv) {
+		printf("%s,%u,%s,%u,%s,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+		       src, ntohs(msg->id.idiag_sport),
+		       dst, ntohs(msg->id.idiag_dport),
+		       mode_str(ci->cesar_mode), ci->cesar_su,
+		       ci->cesar_cwnd_est, ci->cesar_ewma_bw,
+		       ci->cesar_min_rtt, ci->cesar_pacing_gain,
+		       ci->cesar_pattern_count, ci->cesar_su_confidence,
+		       CESAR_INFO_PROFILE(ci->cesar_flags), ci->cesar_flags);
+		return;
+	}
+
+	printf("%s:%u -> %s:%u\n\tcesar:(mode:%s su:%uus%s cwnd_est:%u ewma_bw:%.3fMbps mrtt:%.3f pacing_gain:%.3f pattern:%u su_conf:%u/16 profile:%u%s%s%s%s)\n",
+	       src, ntohs(msg->id.idiag_sport), dst, ntohs(msg->id.idiag_dport),
+	       mode_str(ci->cesar_mode), ci->cesar_su,
+	       ci->cesar_flags & CESAR_INFO_SU_FIXED ? "(fixed)" : "",
+	       ci->cesar_cwnd_est, ci->cesar_ewma_bw * 8.0 / 1e6,
+	       ci->cesar_min_rtt / 1000.0, ci->cesar_pacing_gain / 256.0,
+	       ci->cesar_pattern_count, ci->cesar_su_confidence,
+	       CESAR_INFO_PROFILE(ci->cesar_flags),
+	       ci->cesar_flags & CESAR_INFO_FULL_BW_REACHED ? " full_bw" : "",
+	       ci->cesar_flags & CESAR_INFO_PROBE_RTT ? " probe_rtt" : "",
+	       ci->cesar_flags & CESAR_INFO_SU_PACING ? " su_pacing" : "",
+	       ci->cesar_flags & CESAR_INFO_DST_SHARED ? " shared" : "");
+}
+
+static void parse_msg(const struct nlmsghdr *nlh)
+{
+	const struct inet_diag_msg *msg = NLMSG_DATA(nlh);
+	int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*msg));
+	const struct rtattr *attr = (const struct rtattr *)(msg + 1);
+
+	for (; RTA_OK(attr, len); attr = RTA_NEXT(attr, len)) {
+		struct tcp_cesar_info ci = { 0 };
+		size_t n;
+
+		if (attr->rta_type != INET_DIAG_CESARINFO)
+			continue;
+		n = RTA_PAYLOAD(attr);
+		memcpy(&ci, RTA_DATA(attr), n < sizeof(ci) ? n : sizeof(ci));
+		print_flow(msg, &ci);
+	}
+}
+
+static int dump(int fd, int family)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct inet_diag_req_v2 req;
+	} req = {
+		.nlh = {
+			.nlmsg_len = sizeof(req),
+			.nlmsg_type = SOCK_DIAG_BY_FAMILY,
+			.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+		},
+		.req = {
+			.sdiag_family = family,
+			.sdiag_protocol = IPPROTO_TCP,
+			.idiag_states = ~0U,
+			.idiag_ext = 1 << (INET_DIAG_VEGASINFO - 1),
+		},
+	};
+	static char buf[1 << 16];
+
+	if (send(fd, &req, sizeof(req), 0) < 0)
+		return -errno;
+
+	for (;;) {
+		ssize_t len = recv(fd, buf, sizeof(buf), 0);
+		struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+
+		if (len < 0)
+			return -errno;
+		for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type == NLMSG_DONE)
+				return 0;
+			if (nlh->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+				return err->error;
+			}
+			parse_msg(nlh);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	bool v4 = true, v6 = true;
+	int opt, fd, err = 0;
+
+	while ((opt = getopt(argc, argv, "46ch")) != -1) {
+		switch (opt) {
+		case '4':
+			v6 = false;
+			break;
+		case '6':
+			v4 = false;
+			break;
+		case 'c':
+			csv = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-4 | -6] [-c]\n", argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	if (csv)
+		printf("src,sport,dst,dport,mode,su,cwnd_est,ewma_bw,min_rtt_us,pacing_gain,pattern_count,su_confidence,profile,flags\n");
+	if (v4)
+		err = dump(fd, AF_INET);
+	if (!err && v6)
+		err = dump(fd, AF_INET6);
+	close(fd);
+
+	if (err) {
+		fprintf(stderr, "sock_diag: %s\n", strerror(-err));
+		return 1;
+	}
+	return 0;
+}